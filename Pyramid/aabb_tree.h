@@ -0,0 +1,414 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Axis aligned bounding box
+struct AABB
+{
+    glm::vec3 low;
+    glm::vec3 high;
+
+    float SurfaceArea() const
+    {
+        glm::vec3 size = high - low;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    static AABB Union(const AABB& a, const AABB& b)
+    {
+        return { glm::min(a.low, b.low), glm::max(a.high, b.high) };
+    }
+};
+
+inline bool operator==(const AABB& a, const AABB& b)
+{
+    return a.low == b.low && a.high == b.high;
+}
+
+// returns the box around count positions, each stride floats after the previous one
+inline AABB ComputeBounds(const float* positions, size_t count, size_t stride)
+{
+    AABB box = { glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+    for (size_t i = 0; i < count; i++, positions += stride)
+    {
+        glm::vec3 position(positions[0], positions[1], positions[2]);
+        box.low = glm::min(box.low, position);
+        box.high = glm::max(box.high, position);
+    }
+    return box;
+}
+
+// returns the box around box transformed by an affine matrix, from the transformed centre and the absolute matrix
+// applied to the half extents
+inline AABB TransformBounds(const AABB& box, const glm::mat4& matrix)
+{
+    glm::vec3 centre = (box.low + box.high) * 0.5f;
+    glm::vec3 extent = (box.high - box.low) * 0.5f;
+    glm::vec3 newCentre(matrix[3]);
+    glm::vec3 newExtent(0.0f);
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            newCentre[row] += matrix[column][row] * centre[column];
+            newExtent[row] += std::abs(matrix[column][row]) * extent[column];
+        }
+    }
+    return { newCentre - newExtent, newCentre + newExtent };
+}
+
+// The six planes of a view frustum, extracted from the rows of a projection * view matrix (Gribb and Hartmann). Plane
+// normals point into the frustum
+class Frustum
+{
+public:
+    enum class Containment { Outside, Intersecting, Inside };
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        glm::vec4 rows[4];
+        for (int row = 0; row < 4; row++)
+            rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            planes[axis * 2] = rows[3] + rows[axis];        // Left, bottom, near
+            planes[axis * 2 + 1] = rows[3] - rows[axis];    // Right, top, far
+        }
+    }
+
+    // returns whether box is outside, partly inside or completely inside the frustum. Boxes near a corner of the
+    // frustum can be reported as intersecting although they are outside, which only costs a wasted draw
+    Containment Test(const AABB& box) const
+    {
+        Containment result = Containment::Inside;
+        for (const glm::vec4& plane : planes)
+        {
+            // The corners furthest along and against the plane normal
+            glm::vec3 positive(plane.x >= 0.0f ? box.high.x : box.low.x, plane.y >= 0.0f ? box.high.y : box.low.y, plane.z >= 0.0f ? box.high.z : box.low.z);
+            glm::vec3 negative(plane.x >= 0.0f ? box.low.x : box.high.x, plane.y >= 0.0f ? box.low.y : box.high.y, plane.z >= 0.0f ? box.low.z : box.high.z);
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+                return Containment::Outside;
+            if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f)
+                result = Containment::Intersecting;
+        }
+        return result;
+    }
+
+    // returns the left, right, bottom, top, near and far planes as (normal, distance)
+    const glm::vec4* Planes() const
+    {
+        return planes;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
+
+// A dynamic bounding volume hierarchy: every leaf holds one object's box and an id, every inner node the union of its
+// two children. Leaves are inserted next to the sibling that grows the tree's surface area least and the tree is kept
+// balanced with rotations, as in Box2D's dynamic tree. Moving a leaf refits the boxes of its ancestors without
+// changing the tree's structure, which keeps moves cheap and works well while objects keep their neighbours (the
+// lamps all orbit together); remove and insert a leaf that moves somewhere else entirely
+class AABBTree
+{
+public:
+    static const int32_t NULL_NODE = -1;
+
+    // adds a box, returns the leaf it is stored in
+    int32_t Insert(const AABB& box, uint32_t id)
+    {
+        int32_t leaf = AllocateNode();
+        nodes[leaf].box = box;
+        nodes[leaf].id = id;
+        nodes[leaf].height = 0;
+        InsertLeaf(leaf);
+        leafCount++;
+        return leaf;
+    }
+
+    // removes a leaf returned by Insert
+    void Remove(int32_t leaf)
+    {
+        RemoveLeaf(leaf);
+        FreeNode(leaf);
+        leafCount--;
+    }
+
+    // changes a leaf's box and refits its ancestors
+    void Move(int32_t leaf, const AABB& box)
+    {
+        if (nodes[leaf].box == box)
+            return;
+        nodes[leaf].box = box;
+        for (int32_t index = nodes[leaf].parent; index != NULL_NODE; index = nodes[index].parent)
+        {
+            AABB refitted = AABB::Union(nodes[nodes[index].child1].box, nodes[nodes[index].child2].box);
+            if (nodes[index].box == refitted)
+                break;      // The boxes further up contain this one already
+            nodes[index].box = refitted;
+        }
+    }
+
+    // removes every leaf
+    void Clear()
+    {
+        nodes.clear();
+        root = NULL_NODE;
+        freeList = NULL_NODE;
+        leafCount = 0;
+    }
+
+    // calls visit(id) for every leaf whose box is not outside the frustum, returns the number of boxes tested. Once a
+    // node is completely inside, its leaves are visited without testing their boxes
+    template <typename Visit>
+    size_t Query(const Frustum& frustum, Visit&& visit) const
+    {
+        size_t tested = 0;
+        stack.clear();
+        if (root != NULL_NODE)
+            stack.push_back({ root, false });
+        while (!stack.empty())
+        {
+            StackEntry entry = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[entry.node];
+            bool inside = entry.inside;
+            if (!inside)
+            {
+                tested++;
+                Frustum::Containment containment = frustum.Test(node.box);
+                if (containment == Frustum::Containment::Outside)
+                    continue;
+                inside = containment == Frustum::Containment::Inside;
+            }
+
+            if (node.height == 0)
+                visit(node.id);
+            else
+            {
+                stack.push_back({ node.child1, inside });
+                stack.push_back({ node.child2, inside });
+            }
+        }
+        return tested;
+    }
+
+    // returns the number of leaves
+    size_t Size() const
+    {
+        return leafCount;
+    }
+
+    // returns the number of edges from the root to the deepest leaf
+    int Height() const
+    {
+        return root == NULL_NODE ? 0 : nodes[root].height;
+    }
+
+private:
+    struct Node
+    {
+        AABB box;
+        int32_t parent;
+        int32_t child1;     // NULL_NODE in leaves
+        int32_t child2;
+        uint32_t id;        // Leaves only
+        int32_t height;     // 0 for leaves, -1 for free nodes
+    };
+
+    struct StackEntry
+    {
+        int32_t node;
+        bool inside;        // An ancestor is completely inside the frustum
+    };
+
+    int32_t AllocateNode()
+    {
+        int32_t index;
+        if (freeList != NULL_NODE)
+        {
+            index = freeList;
+            freeList = nodes[index].parent;     // Free nodes are linked through parent
+        }
+        else
+        {
+            index = (int32_t)nodes.size();
+            nodes.push_back(Node());
+        }
+        nodes[index].parent = NULL_NODE;
+        nodes[index].child1 = NULL_NODE;
+        nodes[index].child2 = NULL_NODE;
+        nodes[index].height = 0;
+        return index;
+    }
+
+    void FreeNode(int32_t index)
+    {
+        nodes[index].parent = freeList;
+        nodes[index].height = -1;
+        freeList = index;
+    }
+
+    void InsertLeaf(int32_t leaf)
+    {
+        if (root == NULL_NODE)
+        {
+            root = leaf;
+            nodes[root].parent = NULL_NODE;
+            return;
+        }
+
+        // Walk down to the sibling with the lowest cost: the area of the new parent plus the area every ancestor grows by
+        const AABB box = nodes[leaf].box;
+        int32_t index = root;
+        while (nodes[index].height > 0)
+        {
+            const Node& node = nodes[index];
+            float area = node.box.SurfaceArea();
+            float combinedArea = AABB::Union(node.box, box).SurfaceArea();
+            float cost = 2.0f * combinedArea;                       // Cost of making a new parent for this node and the leaf
+            float inheritanceCost = 2.0f * (combinedArea - area);   // Cost of pushing the leaf further down
+
+            auto descendCost = [&](int32_t child)
+            {
+                float childArea = AABB::Union(box, nodes[child].box).SurfaceArea();
+                if (nodes[child].height > 0)
+                    childArea -= nodes[child].box.SurfaceArea();
+                return childArea + inheritanceCost;
+            };
+            float cost1 = descendCost(node.child1);
+            float cost2 = descendCost(node.child2);
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        // Make a new parent for the sibling and the leaf
+        const int32_t sibling = index;
+        const int32_t oldParent = nodes[sibling].parent;
+        const int32_t newParent = AllocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = AABB::Union(box, nodes[sibling].box);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent == NULL_NODE)
+            root = newParent;
+        else if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+
+        RefitAncestors(nodes[leaf].parent);
+    }
+
+    void RemoveLeaf(int32_t leaf)
+    {
+        if (leaf == root)
+        {
+            root = NULL_NODE;
+            return;
+        }
+
+        // Replace the parent with the leaf's sibling
+        const int32_t parent = nodes[leaf].parent;
+        const int32_t grandParent = nodes[parent].parent;
+        const int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+        nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+        if (grandParent == NULL_NODE)
+        {
+            root = sibling;
+            return;
+        }
+        if (nodes[grandParent].child1 == parent)
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        RefitAncestors(grandParent);
+    }
+
+    // rebalances and recomputes the box and height of index and every node above it
+    void RefitAncestors(int32_t index)
+    {
+        while (index != NULL_NODE)
+        {
+            index = Balance(index);
+            Node& node = nodes[index];
+            node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+            node.box = AABB::Union(nodes[node.child1].box, nodes[node.child2].box);
+            index = node.parent;
+        }
+    }
+
+    // rotates the taller grandchild of a up if a's children differ in height by more than one, returns the node now in
+    // a's place
+    int32_t Balance(int32_t a)
+    {
+        Node& nodeA = nodes[a];
+        if (nodeA.height < 2)
+            return a;
+
+        const int32_t b = nodeA.child1;
+        const int32_t c = nodeA.child2;
+        const int balance = nodes[c].height - nodes[b].height;
+        if (balance > 1)
+            return Rotate(a, c, b, false);
+        if (balance < -1)
+            return Rotate(a, b, c, true);
+        return a;
+    }
+
+    // moves child up into parent's place; parent keeps other and the shorter of child's children, child keeps parent
+    // and its taller child. childIsFirst tells which of parent's children child was
+    int32_t Rotate(int32_t parent, int32_t child, int32_t other, bool childIsFirst)
+    {
+        Node& nodeParent = nodes[parent];
+        Node& nodeChild = nodes[child];
+        const int32_t f = nodeChild.child1;
+        const int32_t g = nodeChild.child2;
+
+        // Child takes parent's place
+        nodeChild.child1 = parent;
+        nodeChild.parent = nodeParent.parent;
+        nodeParent.parent = child;
+        if (nodeChild.parent == NULL_NODE)
+            root = child;
+        else if (nodes[nodeChild.parent].child1 == parent)
+            nodes[nodeChild.parent].child1 = child;
+        else
+            nodes[nodeChild.parent].child2 = child;
+
+        // The taller grandchild stays with child, the shorter one moves to parent
+        const int32_t taller = nodes[f].height > nodes[g].height ? f : g;
+        const int32_t shorter = taller == f ? g : f;
+        nodeChild.child2 = taller;
+        if (childIsFirst)
+            nodeParent.child1 = shorter;
+        else
+            nodeParent.child2 = shorter;
+        nodes[shorter].parent = parent;
+
+        nodeParent.box = AABB::Union(nodes[other].box, nodes[shorter].box);
+        nodeParent.height = 1 + std::max(nodes[other].height, nodes[shorter].height);
+        nodeChild.box = AABB::Union(nodeParent.box, nodes[taller].box);
+        nodeChild.height = 1 + std::max(nodeParent.height, nodes[taller].height);
+        return child;
+    }
+
+    std::vector<Node> nodes;
+    int32_t root = NULL_NODE;
+    int32_t freeList = NULL_NODE;   // Free nodes linked through parent
+    size_t leafCount = 0;
+    mutable std::vector<StackEntry> stack;  // Reused by Query
+};
+#endif
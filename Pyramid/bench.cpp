@@ -0,0 +1,162 @@
+/*
+
+pyramid_bench renders the pyramid scene offscreen in a headless context and reports frame time percentiles. It runs
+the same renderer as the Pyramid application without a window or input, so optimized builds can be compared on
+machines without a display.
+
+Command line options:
+--frames N              Number of frames to render (default 1000)
+--timestep SECONDS      Simulated time per frame (default 1/60)
+--lights N              Replace the two scene lights with N small random lights
+--deferred              Use deferred shading
+--naive                 Shade every light for every fragment instead of clustered lighting
+--output FILE           Write results as JSON, or CSV if FILE ends in .csv
+--pyramids N            Render N pyramids on a grid instead of one
+--shader-cache DIR      Cache linked shader programs in DIR (default shader_cache)
+--no-shader-cache       Always compile shader programs from source
+--light-sweep           Time naive and clustered lighting with 2 to 1024 lights instead
+--stress                Time 100k pyramids drawn instanced and with one draw call each instead
+--upload-benchmark      Compare texture upload MB/s from client memory and through the PBO upload ring instead
+--texture-load          Load the texture 8 times at once and report the time and peak RSS instead
+--mip-benchmark         Compare CPU mip generation Mpixels/s with the scalar reference and glGenerateMipmap instead
+--mesh-benchmark        Report ACMR/ATVR of a shuffled sphere after each mesh optimization step instead
+--orbit-benchmark       Time the orbit of 1M lights with the interleaved glm path and the SoA kernels instead
+--culling-benchmark     Time frustum culling of 10k to 1M pyramids with the bounding volume tree instead
+--no-culling            Draw every pyramid and lamp instead of only the ones inside the view frustum
+--gpu-culling           Cull the pyramids in a compute shader and draw them with one indirect multi-draw call
+--no-mmap               Read texture files with stdio instead of memory mapping them
+--float-vertices        Upload 32 byte float vertices instead of the 16 byte quantized format
+--software              Render on the CPU with the software rasterizer, without a context, and report Mtris/s and
+                        Mpix/s instead
+
+*/
+
+#include <iostream>         // Allow for input/output
+#include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // Command line parsing
+#include <algorithm>        // max
+
+#include "renderer.h" // Scene, shaders and render functions
+#include "headless.h" // Windowless OpenGL context
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    int frameCount = 1000;
+    float timestep = 1.0f / 60.0f;
+    int lightCount = 0;
+    const char* outputFilename = nullptr;
+    bool lightSweep = false;
+    bool stress = false;
+    bool uploadBenchmark = false;
+    bool textureLoad = false;
+    bool mipBenchmark = false;
+    bool meshBenchmark = false;
+    bool orbitBenchmark = false;
+    bool cullingBenchmark = false;
+    bool software = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--timestep") == 0 && i + 1 < argc)
+            timestep = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+            lightCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--deferred") == 0)
+            gUseDeferredShading = true;
+        else if (strcmp(argv[i], "--naive") == 0)
+            gUseClusteredShading = false;
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputFilename = argv[++i];
+        else if (strcmp(argv[i], "--pyramids") == 0 && i + 1 < argc)
+            gPyramidCount = max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+            gShaderCacheDirectory = argv[++i];
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+            gShaderCacheDirectory = nullptr;
+        else if (strcmp(argv[i], "--light-sweep") == 0)
+            lightSweep = true;
+        else if (strcmp(argv[i], "--stress") == 0)
+            stress = true;
+        else if (strcmp(argv[i], "--upload-benchmark") == 0)
+            uploadBenchmark = true;
+        else if (strcmp(argv[i], "--texture-load") == 0)
+            textureLoad = true;
+        else if (strcmp(argv[i], "--mip-benchmark") == 0)
+            mipBenchmark = true;
+        else if (strcmp(argv[i], "--mesh-benchmark") == 0)
+            meshBenchmark = true;
+        else if (strcmp(argv[i], "--orbit-benchmark") == 0)
+            orbitBenchmark = true;
+        else if (strcmp(argv[i], "--culling-benchmark") == 0)
+            cullingBenchmark = true;
+        else if (strcmp(argv[i], "--no-culling") == 0)
+            gUseFrustumCulling = false;
+        else if (strcmp(argv[i], "--gpu-culling") == 0)
+            gUseGpuCulling = true;
+        else if (strcmp(argv[i], "--no-mmap") == 0)
+            gMapTextureFiles = false;
+        else if (strcmp(argv[i], "--float-vertices") == 0)
+            gUseQuantizedVertices = false;
+        else if (strcmp(argv[i], "--software") == 0)
+            software = true;
+        else
+        {
+            cout << "Unknown option " << argv[i] << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The software renderer runs on machines without a GPU, so it never creates a context
+    if (software)
+    {
+        if (lightCount > 0)
+            UPlaceRandomLights(lightCount, 1234);
+        return URunSoftwareRenderer(frameCount, timestep, nullptr) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    HeadlessContext context;
+    if (!context.Create(4, 4))
+        return EXIT_FAILURE;
+    if (!UCreateRenderer())
+        return EXIT_FAILURE;
+
+    RenderTarget target;
+    if (!target.Create(gFramebufferWidth, gFramebufferHeight))
+    {
+        cout << "Failed to create offscreen framebuffer" << endl;
+        return EXIT_FAILURE;
+    }
+    gTargetFramebuffer = target.Framebuffer();
+    glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+
+    if (lightCount > 0)
+        UCreateRandomLights(lightCount, 1234);
+
+    bool success = true;
+    if (lightSweep)
+        ULightSweepBenchmark();
+    else if (stress)
+        UDrawCallBenchmark(100000);
+    else if (uploadBenchmark)
+        UTextureUploadBenchmark();
+    else if (textureLoad)
+        UTextureLoadBenchmark(8);
+    else if (mipBenchmark)
+        UMipmapBenchmark();
+    else if (meshBenchmark)
+        UMeshOptimizationBenchmark();
+    else if (orbitBenchmark)
+        ULightOrbitBenchmark();
+    else if (cullingBenchmark)
+        UCullingBenchmark();
+    else
+        success = URunBenchmark(frameCount, timestep, outputFilename);
+
+    target.Destroy();
+    UDestroyRenderer();
+    context.Destroy();
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Frame time statistics in milliseconds
+struct FrameTimeStats
+{
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+};
+
+// returns the most memory the process has had resident at once since it started
+inline size_t PeakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);           // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;    // Kilobytes on Linux
+#endif
+#endif
+}
+
+// Records CPU and GPU time for a fixed number of frames. Every frame gets its own GL_TIME_ELAPSED query and the
+// results are only read back in Finish, so measuring never waits on the GPU mid-run
+class FrameBenchmark
+{
+public:
+    // allocates the timers for frameCount frames
+    void Begin(int frameCount)
+    {
+        cpuMilliseconds.assign(frameCount, 0.0);
+        gpuMilliseconds.assign(frameCount, 0.0);
+        queries.assign(frameCount, 0);
+        glGenQueries(frameCount, queries.data());
+        frame = 0;
+    }
+
+    // starts timing the next frame
+    void BeginFrame()
+    {
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    // stops timing the current frame
+    void EndFrame()
+    {
+        cpuMilliseconds[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        glEndQuery(GL_TIME_ELAPSED);
+        frame++;
+    }
+
+    // waits for the GPU timers and computes the statistics
+    void Finish()
+    {
+        for (int i = 0; i < frame; i++)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+            gpuMilliseconds[i] = nanoseconds / 1.0e6;
+        }
+        glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+        queries.clear();
+
+        cpuMilliseconds.resize(frame);
+        gpuMilliseconds.resize(frame);
+        cpuStats = ComputeStats(cpuMilliseconds);
+        gpuStats = ComputeStats(gpuMilliseconds);
+    }
+
+    // writes the statistics as JSON, or as CSV if the filename ends in .csv
+    bool Write(const std::string& filename, const std::string& description) const
+    {
+        std::ofstream file(filename);
+        if (!file)
+            return false;
+
+        bool csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+        if (csv)
+        {
+            file << "metric,frames,p50,p95,p99,max,mean\n";
+            WriteCsvRow(file, "cpu_ms", frame, cpuStats);
+            WriteCsvRow(file, "gpu_ms", frame, gpuStats);
+        }
+        else
+        {
+            file << "{\n";
+            file << "  \"description\": \"" << description << "\",\n";
+            file << "  \"frames\": " << frame << ",\n";
+            WriteJsonStats(file, "cpu_ms", cpuStats);
+            file << ",\n";
+            WriteJsonStats(file, "gpu_ms", gpuStats);
+            file << "\n}\n";
+        }
+        return static_cast<bool>(file);
+    }
+
+    int FrameCount() const
+    {
+        return frame;
+    }
+    const FrameTimeStats& CpuStats() const
+    {
+        return cpuStats;
+    }
+    const FrameTimeStats& GpuStats() const
+    {
+        return gpuStats;
+    }
+
+    // nearest rank percentiles of frame times
+    static FrameTimeStats ComputeStats(std::vector<double> samples)
+    {
+        FrameTimeStats stats;
+        if (samples.empty())
+            return stats;
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&samples](double fraction)
+        {
+            size_t rank = static_cast<size_t>(fraction * samples.size() + 0.999999);
+            return samples[std::min(std::max(rank, static_cast<size_t>(1)), samples.size()) - 1];
+        };
+        stats.p50 = percentile(0.50);
+        stats.p95 = percentile(0.95);
+        stats.p99 = percentile(0.99);
+        stats.max = samples.back();
+        for (double sample : samples)
+            stats.mean += sample;
+        stats.mean /= samples.size();
+        return stats;
+    }
+
+private:
+    static void WriteCsvRow(std::ofstream& file, const char* metric, int frames, const FrameTimeStats& stats)
+    {
+        file << metric << "," << frames << "," << stats.p50 << "," << stats.p95 << "," << stats.p99 << "," << stats.max << "," << stats.mean << "\n";
+    }
+
+    static void WriteJsonStats(std::ofstream& file, const char* metric, const FrameTimeStats& stats)
+    {
+        file << "  \"" << metric << "\": { \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99
+             << ", \"max\": " << stats.max << ", \"mean\": " << stats.mean << " }";
+    }
+
+    std::vector<double> cpuMilliseconds;
+    std::vector<double> gpuMilliseconds;
+    std::vector<GLuint> queries;
+    std::chrono::steady_clock::time_point frameStart;
+    int frame = 0;
+    FrameTimeStats cpuStats;
+    FrameTimeStats gpuStats;
+};
+#endif
@@ -0,0 +1,259 @@
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "light_buffer.h"
+
+// Bounds of one cluster in view space (std430, must match struct ClusterBounds in the cluster culling shader)
+struct ClusterAABB
+{
+    glm::vec4 minPoint;
+    glm::vec4 maxPoint;
+};
+
+// Splits the view frustum into screen tiles and exponential depth slices and assigns every light to the clusters its
+// range overlaps, so the fragment shader only evaluates the lights that can reach it. Lights with a range of 0 or less
+// are unbounded and are assigned to every cluster. Culling runs in a compute shader; CullLightsCPU is a reference
+// implementation of the same algorithm used to validate the GPU results. Every cluster's list holds as many lights as
+// the scene has, up to MAX_LIGHTS_PER_CLUSTER; a cluster's count includes the lights that did not fit, so
+// OverflowingClusters can report them
+class ClusterGrid
+{
+public:
+    static const GLuint TILES_X = 16;
+    static const GLuint TILES_Y = 9;
+    static const GLuint SLICES = 24;
+    static const GLuint CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    static const GLuint MIN_LIGHTS_PER_CLUSTER = 256;  // Capacity the light lists are created with
+    static const GLuint MAX_LIGHTS_PER_CLUSTER = 4096; // Largest capacity Reserve grows them to (56 MB of indices)
+    static const GLuint WORKGROUP_SIZE = 64;            // Must match local_size_x of the cluster culling shader
+
+    // creates the cluster buffers and binds them to the given shader storage binding points
+    void Create(GLuint boundsBinding, GLuint countBinding, GLuint indexBinding)
+    {
+        glGenBuffers(1, &boundsBuffer);
+        glGenBuffers(1, &countBuffer);
+        glGenBuffers(1, &indexBuffer);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * sizeof(ClusterAABB), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, boundsBinding, boundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, countBinding, countBuffer);
+        this->indexBinding = indexBinding;
+        capacity = 0;
+        Reserve(MIN_LIGHTS_PER_CLUSTER);
+
+        bounds.resize(CLUSTER_COUNT);
+    }
+
+    // grows every cluster's light list to hold lightCount lights (at most MAX_LIGHTS_PER_CLUSTER), so no light is
+    // dropped from a cluster while the scene has no more lights than that. The lists never shrink
+    void Reserve(GLuint lightCount)
+    {
+        lightCount = std::min(lightCount, MAX_LIGHTS_PER_CLUSTER);
+        if (lightCount <= capacity)
+            return;
+
+        capacity = lightCount;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(CLUSTER_COUNT) * capacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indexBinding, indexBuffer);
+    }
+
+    // returns the number of lights every cluster's list holds (the culling and lighting shaders must be given it)
+    GLuint Capacity() const
+    {
+        return capacity;
+    }
+
+    // releases the cluster buffers
+    void Destroy()
+    {
+        glDeleteBuffers(1, &boundsBuffer);
+        glDeleteBuffers(1, &countBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        boundsBuffer = countBuffer = indexBuffer = 0;
+        capacity = 0;
+    }
+
+    // computes the view space bounds of every cluster, only when the projection has changed since the last call
+    void BuildBounds(const glm::mat4& projection, float nearPlane, float farPlane)
+    {
+        if (projection[0][0] == builtScaleX && projection[1][1] == builtScaleY && nearPlane == builtNear && farPlane == builtFar)
+            return;
+
+        builtScaleX = projection[0][0];
+        builtScaleY = projection[1][1];
+        builtNear = nearPlane;
+        builtFar = farPlane;
+
+        for (GLuint slice = 0; slice < SLICES; slice++)
+        {
+            float sliceNear = SliceDepth(slice);
+            float sliceFar = SliceDepth(slice + 1);
+            for (GLuint tileY = 0; tileY < TILES_Y; tileY++)
+            {
+                for (GLuint tileX = 0; tileX < TILES_X; tileX++)
+                {
+                    // Tile corners in normalized device coordinates
+                    float ndcX0 = -1.0f + 2.0f * tileX / TILES_X;
+                    float ndcX1 = -1.0f + 2.0f * (tileX + 1) / TILES_X;
+                    float ndcY0 = -1.0f + 2.0f * tileY / TILES_Y;
+                    float ndcY1 = -1.0f + 2.0f * (tileY + 1) / TILES_Y;
+
+                    // Project the tile corners onto the near and far depth of the slice
+                    glm::vec3 minPoint(INFINITY);
+                    glm::vec3 maxPoint(-INFINITY);
+                    const float depths[2] = { sliceNear, sliceFar };
+                    for (float depth : depths)
+                    {
+                        const float xs[2] = { ndcX0 * depth / builtScaleX, ndcX1 * depth / builtScaleX };
+                        const float ys[2] = { ndcY0 * depth / builtScaleY, ndcY1 * depth / builtScaleY };
+                        for (float x : xs)
+                        {
+                            for (float y : ys)
+                            {
+                                minPoint = glm::min(minPoint, glm::vec3(x, y, -depth));
+                                maxPoint = glm::max(maxPoint, glm::vec3(x, y, -depth));
+                            }
+                        }
+                    }
+                    bounds[ClusterIndex(tileX, tileY, slice)] = { glm::vec4(minPoint, 1.0f), glm::vec4(maxPoint, 1.0f) };
+                }
+            }
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bounds.size() * sizeof(ClusterAABB), bounds.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // dispatches the cluster culling shader (the program must be bound and its view matrix set)
+    void Cull() const
+    {
+        glDispatchCompute((CLUSTER_COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);     // Fragment shaders read the light lists
+    }
+
+    // reference implementation of the cluster culling shader
+    void CullLightsCPU(const std::vector<GPULight>& lights, const glm::mat4& view, std::vector<GLuint>& counts, std::vector<GLuint>& indices) const
+    {
+        counts.assign(CLUSTER_COUNT, 0);
+        indices.assign(static_cast<size_t>(CLUSTER_COUNT) * capacity, 0);
+
+        for (GLuint cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            GLuint count = 0;
+            size_t base = static_cast<size_t>(cluster) * capacity;
+            for (GLuint i = 0; i < lights.size(); i++)
+            {
+                float range = lights[i].color.w;
+                glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].positionIntensity), 1.0f));
+                if (range <= 0.0f || SphereIntersectsAABB(center, range, bounds[cluster]))
+                {
+                    if (count < capacity)
+                        indices[base + count] = i;
+                    count++;        // Lights that do not fit are still counted
+                }
+            }
+            counts[cluster] = count;
+        }
+    }
+
+    // reads back the GPU light lists and compares them with CullLightsCPU, returns the number of clusters that differ
+    GLuint Validate(const std::vector<GPULight>& lights, const glm::mat4& view) const
+    {
+        std::vector<GLuint> cpuCounts, cpuIndices;
+        CullLightsCPU(lights, view, cpuCounts, cpuIndices);
+
+        std::vector<GLuint> gpuCounts = ReadCounts();
+        std::vector<GLuint> gpuIndices(static_cast<size_t>(CLUSTER_COUNT) * capacity);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuIndices.size() * sizeof(GLuint), gpuIndices.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        GLuint mismatches = 0;
+        for (GLuint cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            bool same = cpuCounts[cluster] == gpuCounts[cluster];
+            size_t base = static_cast<size_t>(cluster) * capacity;
+            for (GLuint j = 0; same && j < std::min(cpuCounts[cluster], capacity); j++)
+                same = cpuIndices[base + j] == gpuIndices[base + j];
+            if (!same)
+                mismatches++;
+        }
+        return mismatches;
+    }
+
+    // reads back the light counts of the last Cull, returns the number of clusters that reached more lights than their
+    // list holds and adds the lights left out of them to droppedLights
+    GLuint OverflowingClusters(GLuint& droppedLights) const
+    {
+        GLuint overflowing = 0;
+        for (GLuint count : ReadCounts())
+        {
+            if (count > capacity)
+            {
+                overflowing++;
+                droppedLights += count - capacity;
+            }
+        }
+        return overflowing;
+    }
+
+private:
+    // returns the light count of every cluster written by the last Cull
+    std::vector<GLuint> ReadCounts() const
+    {
+        std::vector<GLuint> counts(CLUSTER_COUNT);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, counts.size() * sizeof(GLuint), counts.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return counts;
+    }
+
+    // returns the view space depth where a slice begins (slices are spaced exponentially between near and far)
+    float SliceDepth(GLuint slice) const
+    {
+        return builtNear * std::pow(builtFar / builtNear, static_cast<float>(slice) / SLICES);
+    }
+
+    static GLuint ClusterIndex(GLuint tileX, GLuint tileY, GLuint slice)
+    {
+        return tileX + TILES_X * (tileY + TILES_Y * slice);
+    }
+
+    static bool SphereIntersectsAABB(const glm::vec3& center, float radius, const ClusterAABB& box)
+    {
+        glm::vec3 closest = glm::min(glm::max(center, glm::vec3(box.minPoint)), glm::vec3(box.maxPoint));
+        glm::vec3 offset = closest - center;
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    GLuint boundsBuffer = 0;
+    GLuint countBuffer = 0;
+    GLuint indexBuffer = 0;
+    GLuint indexBinding = 0;
+    GLuint capacity = 0;                // Lights each cluster's list holds
+    std::vector<ClusterAABB> bounds;    // CPU copy of the cluster bounds
+
+    // Projection the bounds were built for
+    float builtScaleX = 0.0f;
+    float builtScaleY = 0.0f;
+    float builtNear = 0.0f;
+    float builtFar = 0.0f;
+};
+#endif
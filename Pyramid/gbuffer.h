@@ -0,0 +1,104 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <GL/glew.h>
+
+// Geometry buffer for deferred shading. The geometry pass writes world position, normal and albedo for every pixel and
+// the lighting pass shades each pixel once from these textures. Attachments are stored as 32 bit floats so the
+// lighting pass sees exactly the values the forward shader interpolates
+class GBuffer
+{
+public:
+    static const GLuint ATTACHMENT_COUNT = 3;   // Position, normal, albedo (must match the G-buffer fragment shader)
+
+    // creates the framebuffer and its attachments
+    bool Create(int frameWidth, int frameHeight)
+    {
+        width = frameWidth;
+        height = frameHeight;
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        // Color attachments
+        glGenTextures(ATTACHMENT_COUNT, textures);
+        GLenum drawBuffers[ATTACHMENT_COUNT];
+        for (GLuint i = 0; i < ATTACHMENT_COUNT; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        glDrawBuffers(ATTACHMENT_COUNT, drawBuffers);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Depth attachment, same format as the default framebuffer so it can be blitted for forward drawn objects
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    // releases the framebuffer and its attachments
+    void Destroy()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(ATTACHMENT_COUNT, textures);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        framebuffer = depthBuffer = 0;
+        width = height = 0;
+    }
+
+    // recreates the attachments if the frame size has changed
+    bool Resize(int frameWidth, int frameHeight)
+    {
+        if (frameWidth == width && frameHeight == height)
+            return true;
+        Destroy();
+        return Create(frameWidth, frameHeight);
+    }
+
+    // binds the framebuffer and clears it for the geometry pass
+    void BeginGeometryPass() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);   // Position w of 0 marks pixels without geometry
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // binds the attachments to consecutive texture units for the lighting pass
+    void BindTextures(GLuint firstUnit) const
+    {
+        for (GLuint i = 0; i < ATTACHMENT_COUNT; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // copies the geometry pass depth into another framebuffer so objects drawn afterwards are depth tested
+    void BlitDepth(GLuint targetFramebuffer) const
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    }
+
+private:
+    GLuint framebuffer = 0;
+    GLuint textures[ATTACHMENT_COUNT] = { 0, 0, 0 };
+    GLuint depthBuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+#endif
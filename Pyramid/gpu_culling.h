@@ -0,0 +1,187 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// World space bounds of one scene object (std430, must match struct ObjectBounds in the object culling shader)
+struct GPUObjectBounds
+{
+    glm::vec4 low;
+    glm::vec4 high;
+};
+
+// One indexed draw, laid out as glMultiDrawElementsIndirect reads it (must match struct DrawCommand in the object
+// culling shader)
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Culls the scene objects against the view frustum in a compute shader and draws the visible ones without the CPU
+// issuing a draw per object or knowing which were visible. Object i is drawn as instance i of the mesh (its model
+// matrix is read from the instance buffer through baseInstance); the shader appends one indirect command per visible
+// object and counts them, and glMultiDrawElementsIndirectCountARB reads the count from the GPU buffer. Without
+// ARB_indirect_parameters the shader instead writes every object's command in place, culled ones with an instance
+// count of 0, and all of them are submitted with glMultiDrawElementsIndirect
+class GpuCulling
+{
+public:
+    static const GLuint WORKGROUP_SIZE = 64;    // Must match local_size_x of the object culling shader
+
+    // creates the buffers and binds them to the given shader storage binding points
+    void Create(GLuint boundsBinding, GLuint commandBinding, GLuint countBinding)
+    {
+        glGenBuffers(1, &boundsBuffer);
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &countBuffer);
+        glGenBuffers(2, readbackBuffers);
+        this->boundsBinding = boundsBinding;
+        this->commandBinding = commandBinding;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, countBinding, countBuffer);
+        for (GLuint readback : readbackBuffers)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, readback);
+            glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        Reserve(16);
+    }
+
+    // releases the buffers
+    void Destroy()
+    {
+        glDeleteBuffers(1, &boundsBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &countBuffer);
+        glDeleteBuffers(2, readbackBuffers);
+        for (GLsync& fence : readbackFences)
+        {
+            if (fence != nullptr)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        boundsBuffer = commandBuffer = countBuffer = 0;
+        capacity = 0;
+    }
+
+    // uploads the bounds of every object, object i is drawn as instance i
+    void SetObjects(const std::vector<GPUObjectBounds>& bounds)
+    {
+        objectCount = (GLuint)bounds.size();
+        if (objectCount > capacity)
+            Reserve(objectCount * 2);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bounds.size() * sizeof(GPUObjectBounds), bounds.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // dispatches the object culling shader (the program must be bound and its frustum planes, object count, index
+    // count and compact flag set, compact being DrawCountSupported())
+    void Cull()
+    {
+        // Copy the last frame's count out before it is reset, VisibleCount reads it a frame later still
+        readbackIndex ^= 1;
+        glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[readbackIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GLuint));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (readbackFences[readbackIndex] != nullptr)
+            glDeleteSync(readbackFences[readbackIndex]);
+        readbackFences[readbackIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        const GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        if (objectCount > 0)
+            glDispatchCompute((objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        // The draw reads the commands and the count, the next Cull copies and clears the count
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    // draws the commands written by Cull with the bound vertex array, index type and program
+    void Draw(GLenum indexType) const
+    {
+        if (objectCount == 0)
+            return;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        if (DrawCountSupported())
+        {
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+            glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, indexType, nullptr, 0, objectCount, 0);
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+        }
+        else
+            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr, objectCount, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // returns the number of objects the shader found visible two calls to Cull ago. The count is only read once the
+    // copy holding it has completed; until then the last count read is returned, so the CPU never waits for the GPU
+    GLuint VisibleCount()
+    {
+        GLsync& fence = readbackFences[readbackIndex ^ 1];
+        if (fence == nullptr || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return visibleCount;
+
+        glDeleteSync(fence);
+        fence = nullptr;
+        glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffers[readbackIndex ^ 1]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &visibleCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return visibleCount;
+    }
+
+    GLuint ObjectCount() const
+    {
+        return objectCount;
+    }
+
+    // returns true if the draw count can be read from a buffer, so only visible objects are submitted
+    static bool DrawCountSupported()
+    {
+        return GLEW_ARB_indirect_parameters;
+    }
+
+private:
+    // grows the bounds and command buffers to hold count objects, rebinding them as the buffer names stay the same
+    void Reserve(GLuint count)
+    {
+        capacity = count;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GPUObjectBounds), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, boundsBinding, boundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandBinding, commandBuffer);
+    }
+
+    GLuint boundsBuffer = 0;
+    GLuint commandBuffer = 0;           // Written by the shader, read by the draw as GL_DRAW_INDIRECT_BUFFER
+    GLuint countBuffer = 0;             // Visible objects, read by the draw as GL_PARAMETER_BUFFER_ARB
+    GLuint readbackBuffers[2] = {};     // Earlier frames' counts, read back for statistics
+    GLuint readbackIndex = 0;
+    GLsync readbackFences[2] = {};      // Signaled once the copy into each readback buffer has completed
+    GLuint visibleCount = 0;            // Last count read back
+    GLuint boundsBinding = 0;
+    GLuint commandBinding = 0;
+    GLuint capacity = 0;
+    GLuint objectCount = 0;
+};
+#endif
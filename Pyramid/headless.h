@@ -0,0 +1,162 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifdef PYRAMID_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <iostream>
+
+// Creates an OpenGL context without a visible window so frames can be rendered on machines without a display. When
+// built with PYRAMID_EGL the context comes from EGL on a surfaceless display (falling back to a 1x1 pbuffer), which runs
+// on Mesa's llvmpipe on GPU-less Linux machines. Otherwise a hidden GLFW window provides the context
+class HeadlessContext
+{
+public:
+    // creates the context, makes it current and initializes GLEW
+    bool Create(int majorVersion, int minorVersion)
+    {
+#ifdef PYRAMID_EGL
+        if (!CreateEGLContext(majorVersion, minorVersion))
+            return false;
+
+        // glewInit looks for a GLX display, only load the GL entry points
+        glewExperimental = GL_TRUE;
+        GLenum GlewInitResult = glewContextInit();
+#else
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, majorVersion);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minorVersion);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        window = glfwCreateWindow(1, 1, "Headless", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create hidden GLFW window" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+
+        glewExperimental = GL_TRUE;
+        GLenum GlewInitResult = glewInit();
+#endif
+        if (GLEW_OK != GlewInitResult)
+        {
+            std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+            return false;
+        }
+
+        std::cout << "Headless context: " << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION) << std::endl;
+        return true;
+    }
+
+    // releases the context
+    void Destroy()
+    {
+#ifdef PYRAMID_EGL
+        if (display != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (surface != EGL_NO_SURFACE)
+                eglDestroySurface(display, surface);
+            if (context != EGL_NO_CONTEXT)
+                eglDestroyContext(display, context);
+            eglTerminate(display);
+        }
+        display = EGL_NO_DISPLAY;
+        surface = EGL_NO_SURFACE;
+        context = EGL_NO_CONTEXT;
+#else
+        if (window != NULL)
+        {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        window = NULL;
+#endif
+    }
+
+private:
+#ifdef PYRAMID_EGL
+    bool CreateEGLContext(int majorVersion, int minorVersion)
+    {
+        // Prefer Mesa's surfaceless platform, which needs neither a display server nor a GPU
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint eglMajor = 0, eglMinor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor))
+        {
+            std::cout << "Failed to initialize EGL display" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "EGL display does not support desktop OpenGL" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            std::cout << "No suitable EGL config" << std::endl;
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+            EGL_CONTEXT_MINOR_VERSION, minorVersion,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cout << "Failed to create EGL context for OpenGL " << majorVersion << "." << minorVersion << std::endl;
+            return false;
+        }
+
+        // Frames go to a framebuffer object, so no surface is needed if the driver allows it
+        if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+            return true;
+
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context))
+        {
+            std::cout << "Failed to make EGL context current" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+#else
+    GLFWwindow* window = NULL;
+#endif
+};
+#endif
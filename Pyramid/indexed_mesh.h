@@ -0,0 +1,88 @@
+#ifndef INDEXED_MESH_H
+#define INDEXED_MESH_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// A triangle list that shares its vertices: each unique vertex is stored once and the triangles refer to it by index,
+// so vertices used by several triangles are transformed once while they stay in the post-transform cache
+struct IndexedMesh
+{
+    int floatsPerVertex = 0;
+    std::vector<float> vertices;    // Unique vertices, floatsPerVertex floats each
+    std::vector<uint32_t> indices;  // Three per triangle
+
+    size_t VertexCount() const
+    {
+        return floatsPerVertex > 0 ? vertices.size() / floatsPerVertex : 0;
+    }
+
+    // returns GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise
+    GLenum IndexType() const
+    {
+        return VertexCount() <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    // returns the index buffer contents in IndexType's format
+    std::vector<unsigned char> PackedIndices() const
+    {
+        std::vector<unsigned char> packed;
+        if (IndexType() == GL_UNSIGNED_SHORT)
+        {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            packed.resize(shortIndices.size() * sizeof(uint16_t));
+            memcpy(packed.data(), shortIndices.data(), packed.size());
+        }
+        else
+        {
+            packed.resize(indices.size() * sizeof(uint32_t));
+            memcpy(packed.data(), indices.data(), packed.size());
+        }
+        return packed;
+    }
+};
+
+// builds an indexed mesh from a fully expanded triangle list, welding vertices whose attributes (position, normal,
+// texture coordinates, ...) are bit for bit identical. The first occurrence of a vertex keeps its place
+inline IndexedMesh WeldVertices(const float* vertices, size_t vertexCount, int floatsPerVertex)
+{
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = floatsPerVertex;
+    mesh.indices.reserve(vertexCount);
+
+    const size_t vertexBytes = sizeof(float) * floatsPerVertex;
+    std::unordered_multimap<uint64_t, uint32_t> uniqueVertices;     // FNV-1a hash of the vertex bytes to its index
+    uniqueVertices.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float* vertex = vertices + i * floatsPerVertex;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertex);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t b = 0; b < vertexBytes; b++)
+            hash = (hash ^ bytes[b]) * 1099511628211ull;
+
+        uint32_t index = UINT32_MAX;
+        auto candidates = uniqueVertices.equal_range(hash);
+        for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+        {
+            if (memcmp(mesh.vertices.data() + static_cast<size_t>(candidate->second) * floatsPerVertex, vertex, vertexBytes) == 0)
+            {
+                index = candidate->second;
+                break;
+            }
+        }
+        if (index == UINT32_MAX)
+        {
+            index = static_cast<uint32_t>(mesh.VertexCount());
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + floatsPerVertex);
+            uniqueVertices.emplace(hash, index);
+        }
+        mesh.indices.push_back(index);
+    }
+    return mesh;
+}
+#endif
@@ -0,0 +1,135 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Per-instance vertex attributes (must match the instance attribute locations in the shaders)
+struct GPUInstance
+{
+    glm::mat4 model;    // Locations firstLocation to firstLocation + 3, one column each
+    glm::vec4 color;    // Location firstLocation + 4
+};
+
+// Holds one model matrix and color per drawn object in a vertex buffer whose attributes advance once per instance, so
+// any number of objects sharing a mesh draw with one glDrawElementsInstanced call. Only the range of instances changed
+// since the last upload is written
+class InstanceBuffer
+{
+public:
+    static const GLuint ATTRIBUTE_COUNT = 5;    // Vertex attribute locations used by one instance
+
+    // creates the buffer and adds its attributes to a vertex array object starting at firstLocation
+    void Create(GLuint vao, GLuint firstLocation)
+    {
+        glGenBuffers(1, &buffer);
+        Reserve(16);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(firstLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(GPUInstance), (void*)(offsetof(GPUInstance, model) + sizeof(glm::vec4) * column));
+            glEnableVertexAttribArray(firstLocation + column);
+            glVertexAttribDivisor(firstLocation + column, 1);
+        }
+        glVertexAttribPointer(firstLocation + 4, 4, GL_FLOAT, GL_FALSE, sizeof(GPUInstance), (void*)offsetof(GPUInstance, color));
+        glEnableVertexAttribArray(firstLocation + 4);
+        glVertexAttribDivisor(firstLocation + 4, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // releases the buffer
+    void Destroy()
+    {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        capacity = 0;
+    }
+
+    // sets the number of instances in the buffer
+    void Resize(size_t count)
+    {
+        if (count != instances.size())
+        {
+            instances.resize(count);
+            MarkDirty(0, count);
+        }
+    }
+
+    // stores one instance, marking it for upload
+    void Set(size_t index, const glm::mat4& model, const glm::vec4& color)
+    {
+        instances[index].model = model;
+        instances[index].color = color;
+        MarkDirty(index, index + 1);
+    }
+
+    // uploads the changed instances, returns true if the buffer was written
+    bool Upload()
+    {
+        if (dirtyBegin >= dirtyEnd)
+            return false;
+
+        if (instances.size() > capacity)
+        {
+            Reserve(instances.size() * 2);
+            dirtyBegin = 0;
+            dirtyEnd = instances.size();
+        }
+
+        dirtyEnd = std::min(dirtyEnd, instances.size());
+        if (dirtyBegin < dirtyEnd)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(GPUInstance), (dirtyEnd - dirtyBegin) * sizeof(GPUInstance), instances.data() + dirtyBegin);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        dirtyBegin = dirtyEnd = 0;
+        return true;
+    }
+
+    // returns the number of instances in the buffer
+    size_t Count() const
+    {
+        return instances.size();
+    }
+
+private:
+    // grows the GPU buffer to hold count instances (the vertex array keeps referring to the same buffer name)
+    void Reserve(size_t count)
+    {
+        capacity = count;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GPUInstance), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void MarkDirty(size_t begin, size_t end)
+    {
+        if (dirtyBegin >= dirtyEnd)
+        {
+            dirtyBegin = begin;
+            dirtyEnd = end;
+        }
+        else
+        {
+            dirtyBegin = std::min(dirtyBegin, begin);
+            dirtyEnd = std::max(dirtyEnd, end);
+        }
+    }
+
+    GLuint buffer = 0;
+    size_t capacity = 0;
+    size_t dirtyBegin = 0;  // Range of instances changed since the last upload
+    size_t dirtyEnd = 0;
+    std::vector<GPUInstance> instances;     // CPU copy of the buffer contents
+};
+#endif
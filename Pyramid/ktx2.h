@@ -0,0 +1,253 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Reads and writes the subset of the KTX2 container used for cooked textures: a single 2D image (no array layers, cube
+// faces or supercompression) in a block compressed format, with its whole mip chain. Level 0 is the full size image;
+// the file stores the smallest level first as the format requires
+
+// Vulkan format numbers of the block compressed formats the texture loader can upload
+const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+const uint32_t VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132;
+const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+const uint32_t VK_FORMAT_BC7_SRGB_BLOCK = 146;
+const uint32_t VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK = 147;
+const uint32_t VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK = 148;
+
+// One mip level of a KTX2 image
+struct KTX2Level
+{
+    int width;
+    int height;
+    size_t offset;  // From the start of the file
+    size_t size;
+};
+
+// A parsed KTX2 image. The levels point into the file contents, which are either mapped by the caller or read into
+// storage; moving the image keeps data valid, copying it does not
+struct KTX2Image
+{
+    uint32_t vkFormat = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<KTX2Level> levels;      // Level 0 first
+    const unsigned char* data = nullptr;
+    std::vector<unsigned char> storage; // The file contents if it was read rather than mapped
+};
+
+// returns the bytes per 4x4 block of a supported format, 0 for anything else
+inline uint32_t KTX2BlockSize(uint32_t vkFormat)
+{
+    switch (vkFormat)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+namespace ktx2
+{
+    const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // Layout of the file header that follows the identifier. The two 64 bit fields are stored as pairs of 32 bit
+    // words (low word first, as the file is little endian) because a uint64_t after thirteen uint32_t would be
+    // padded to offset 56
+    struct Header
+    {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint32_t sgdByteOffset[2];
+        uint32_t sgdByteLength[2];
+    };
+    static_assert(sizeof(Header) == 68, "KTX2 header must be 68 bytes");
+
+    struct LevelIndex
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+    static_assert(sizeof(LevelIndex) == 24, "KTX2 level index entries must be 24 bytes");
+
+    inline size_t LevelSize(uint32_t vkFormat, int width, int height)
+    {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * KTX2BlockSize(vkFormat);
+    }
+
+    // builds the basic data format descriptor of a block compressed format (one sample covering the whole block)
+    inline std::vector<uint32_t> DataFormatDescriptor(uint32_t vkFormat)
+    {
+        uint32_t colorModel = 128;                      // KHR_DF_MODEL_BC1A
+        if (vkFormat == VK_FORMAT_BC7_UNORM_BLOCK || vkFormat == VK_FORMAT_BC7_SRGB_BLOCK)
+            colorModel = 133;                           // KHR_DF_MODEL_BC7
+        else if (vkFormat == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK || vkFormat == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK)
+            colorModel = 161;                           // KHR_DF_MODEL_ETC2
+        bool srgb = vkFormat == VK_FORMAT_BC1_RGB_SRGB_BLOCK || vkFormat == VK_FORMAT_BC7_SRGB_BLOCK || vkFormat == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+        uint32_t blockSize = KTX2BlockSize(vkFormat);
+
+        const uint32_t sampleCount = 1;
+        const uint32_t blockBytes = 24 + 16 * sampleCount;
+        return {
+            4 + blockBytes,                             // Total size
+            0,                                          // Khronos vendor, basic descriptor type
+            2 | (blockBytes << 16),                     // Version 1.3, descriptor block size
+            colorModel | (1 << 8) | ((srgb ? 2u : 1u) << 16),  // BT.709 primaries, linear or sRGB transfer
+            3 | (3 << 8),                               // 4x4x1x1 texel block
+            blockSize,                                  // Bytes in plane 0
+            0,
+            0 | ((blockSize * 8 - 1) << 16),            // Sample at bit 0 covering the block, color channel
+            0,
+            0,
+            0xFFFFFFFF
+        };
+    }
+}
+
+// parses the KTX2 file contents at file without copying them, returns false with a reason in error if they cannot be
+// used. The contents must outlive the image
+inline bool ParseKTX2(const unsigned char* file, size_t fileSize, KTX2Image& image, std::string& error)
+{
+    image.levels.clear();
+    image.data = file;
+
+    ktx2::Header header;
+    const size_t headerSize = sizeof(ktx2::IDENTIFIER) + sizeof(header);
+    if (fileSize < headerSize || memcmp(file, ktx2::IDENTIFIER, sizeof(ktx2::IDENTIFIER)) != 0)
+    {
+        error = "not a KTX2 file";
+        return false;
+    }
+    memcpy(&header, file + sizeof(ktx2::IDENTIFIER), sizeof(header));
+    if (KTX2BlockSize(header.vkFormat) == 0)
+        error = "unsupported format " + std::to_string(header.vkFormat);
+    else if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0)
+        error = "only 2D images without supercompression are supported";
+    else if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.levelCount == 0 || header.levelCount > 16)
+        error = "invalid dimensions";
+    else if (fileSize < headerSize + header.levelCount * sizeof(ktx2::LevelIndex))
+        error = "truncated level index";
+    if (!error.empty())
+        return false;
+
+    image.vkFormat = header.vkFormat;
+    image.width = static_cast<int>(header.pixelWidth);
+    image.height = static_cast<int>(header.pixelHeight);
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        ktx2::LevelIndex levelIndex;
+        memcpy(&levelIndex, file + headerSize + level * sizeof(levelIndex), sizeof(levelIndex));
+
+        int width = image.width >> level > 0 ? image.width >> level : 1;
+        int height = image.height >> level > 0 ? image.height >> level : 1;
+        size_t size = ktx2::LevelSize(header.vkFormat, width, height);
+        if (levelIndex.byteLength != size)
+            error = "level " + std::to_string(level) + " has the wrong size";
+        else if (levelIndex.byteOffset > fileSize || fileSize - levelIndex.byteOffset < size)
+            error = "truncated level " + std::to_string(level);
+        if (!error.empty())
+        {
+            image.levels.clear();
+            return false;
+        }
+        image.levels.push_back({ width, height, static_cast<size_t>(levelIndex.byteOffset), size });
+    }
+    return true;
+}
+
+// reads a whole KTX2 file into the image's storage and parses it, returns false with a reason in error if it cannot be
+// used
+inline bool ReadKTX2(const std::string& filename, KTX2Image& image, std::string& error)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+    {
+        error = "cannot open file";
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    image.storage.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+    bool read = fread(image.storage.data(), 1, image.storage.size(), file) == image.storage.size();
+    fclose(file);
+    if (!read)
+    {
+        error = "cannot read file";
+        return false;
+    }
+    return ParseKTX2(image.storage.data(), image.storage.size(), image, error);
+}
+
+// writes a KTX2 file from the compressed mip levels of an image (level 0 first), returns false if it cannot be written
+inline bool WriteKTX2(const std::string& filename, uint32_t vkFormat, int width, int height, const std::vector<std::vector<unsigned char>>& levels)
+{
+    const std::vector<uint32_t> dfd = ktx2::DataFormatDescriptor(vkFormat);
+    const size_t dfdOffset = sizeof(ktx2::IDENTIFIER) + sizeof(ktx2::Header) + levels.size() * sizeof(ktx2::LevelIndex);
+    const size_t dfdSize = dfd.size() * sizeof(uint32_t);
+
+    // Levels are stored smallest first, each aligned to the block size
+    const size_t alignment = KTX2BlockSize(vkFormat);
+    std::vector<ktx2::LevelIndex> levelIndex(levels.size());
+    size_t offset = dfdOffset + dfdSize;
+    for (size_t level = levels.size(); level-- > 0;)
+    {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        levelIndex[level] = { offset, levels[level].size(), levels[level].size() };
+        offset += levels[level].size();
+    }
+
+    ktx2::Header header = {};
+    header.vkFormat = vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.dfdByteOffset = static_cast<uint32_t>(dfdOffset);
+    header.dfdByteLength = static_cast<uint32_t>(dfdSize);
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    fwrite(ktx2::IDENTIFIER, sizeof(ktx2::IDENTIFIER), 1, file);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(levelIndex.data(), sizeof(ktx2::LevelIndex), levelIndex.size(), file);
+    fwrite(dfd.data(), sizeof(uint32_t), dfd.size(), file);
+
+    size_t written = dfdOffset + dfdSize;
+    for (size_t level = levels.size(); level-- > 0;)
+    {
+        const unsigned char padding[16] = {};
+        fwrite(padding, 1, levelIndex[level].byteOffset - written, file);
+        fwrite(levels[level].data(), 1, levels[level].size(), file);
+        written = levelIndex[level].byteOffset + levels[level].size();
+    }
+    bool success = ferror(file) == 0;
+    fclose(file);
+    return success;
+}
+#endif
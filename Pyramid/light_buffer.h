@@ -0,0 +1,120 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Layout of one light in the shader storage buffer (std430, must match struct Light in the shaders)
+struct GPULight
+{
+    glm::vec4 positionIntensity;    // xyz : world position, w : intensity
+    glm::vec4 color;                // rgb : color, a : range (0 or less for an unbounded light)
+};
+
+// Layout of the header that precedes the light array in the shader storage buffer
+struct GPULightHeader
+{
+    GLuint lightCount;
+    GLuint padding[3];  // The light array starts on a 16 byte boundary
+};
+
+// Packs the scene lights into a single shader storage buffer so any number of lights can be uploaded with one call
+// per frame. The buffer is only re-uploaded when a light has changed since the last upload
+class LightBuffer
+{
+public:
+    // creates the buffer and binds it to the shader storage binding point used by the shaders
+    void Create(GLuint bindingPoint)
+    {
+        binding = bindingPoint;
+        glGenBuffers(1, &buffer);
+        Reserve(16);
+    }
+
+    // releases the buffer
+    void Destroy()
+    {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        capacity = 0;
+    }
+
+    // sets the number of lights in the buffer
+    void Resize(size_t count)
+    {
+        if (count != lights.size())
+        {
+            lights.resize(count);
+            dirty = true;
+        }
+    }
+
+    // stores one light, marking the buffer for upload
+    void Set(size_t index, const glm::vec3& position, const glm::vec3& color, float intensity, float range)
+    {
+        lights[index].positionIntensity = glm::vec4(position, intensity);
+        lights[index].color = glm::vec4(color, range);
+        dirty = true;
+    }
+
+    // uploads the lights if anything changed, returns true if the buffer was written
+    bool Upload()
+    {
+        if (!dirty)
+            return false;
+
+        if (lights.size() > capacity)
+            Reserve(lights.size() * 2);
+
+        GPULightHeader header = { static_cast<GLuint>(lights.size()), { 0, 0, 0 } };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+        if (!lights.empty())
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), lights.size() * sizeof(GPULight), lights.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        dirty = false;
+        return true;
+    }
+
+    // returns the number of lights in the buffer
+    size_t Count() const
+    {
+        return lights.size();
+    }
+
+    // returns the CPU copy of the packed lights
+    const std::vector<GPULight>& Lights() const
+    {
+        return lights;
+    }
+
+    // returns the OpenGL handle of the buffer
+    GLuint Handle() const
+    {
+        return buffer;
+    }
+
+private:
+    // grows the GPU buffer to hold count lights and rebinds it
+    void Reserve(size_t count)
+    {
+        capacity = count;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPULightHeader) + capacity * sizeof(GPULight), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+        dirty = true;
+    }
+
+    GLuint buffer = 0;
+    GLuint binding = 0;
+    size_t capacity = 0;
+    bool dirty = true;
+    std::vector<GPULight> lights;   // CPU copy of the buffer contents
+};
+#endif
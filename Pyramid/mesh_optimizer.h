@@ -0,0 +1,333 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "indexed_mesh.h"
+
+// Reorders indexed meshes for the GPU without changing what they look like. Vertex cache optimization orders triangles
+// so their vertices are still in the post-transform cache (Tom Forsyth's linear-speed algorithm), overdraw optimization
+// then moves the clusters of triangles facing away from the mesh centre to the front so they occlude the rest, and
+// vertex fetch optimization numbers the vertices in the order they are first used. Positions must be the first three
+// floats of each vertex
+
+// Post-transform cache efficiency of a mesh: ACMR is transformed vertices per triangle (0.5 at best on a regular grid,
+// 3 at worst), ATVR transformed vertices per unique vertex (1 at best)
+struct VertexCacheStats
+{
+    double acmr = 0.0;
+    double atvr = 0.0;
+};
+
+namespace mesh_optimizer
+{
+    const int CACHE_SIZE = 32;      // Modelled cache of the Forsyth scores
+    const int MAX_VALENCE = 32;
+
+    // returns how much a vertex wants its triangles emitted: more when it was used recently and when few of its
+    // triangles are left
+    inline float VertexScore(int cachePosition, uint32_t remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+                score = 0.75f;  // Used by the last triangle; fixed so the next triangle does not favour any of its edges
+            else
+                score = std::pow(1.0f - (cachePosition - 3) / float(CACHE_SIZE - 3), 1.5f);
+        }
+        return score + 2.0f / std::sqrt(float(std::min<uint32_t>(remainingTriangles, MAX_VALENCE)));
+    }
+}
+
+// simulates a FIFO post-transform cache of cacheSize vertices over the triangles in index order
+inline VertexCacheStats AnalyzeVertexCache(const IndexedMesh& mesh, int cacheSize = 16)
+{
+    VertexCacheStats stats;
+    if (mesh.indices.empty())
+        return stats;
+
+    // A vertex is cached while fewer than cacheSize misses have happened since it was loaded
+    std::vector<int64_t> loadedAt(mesh.VertexCount(), INT64_MIN / 2);
+    int64_t misses = 0;
+    for (uint32_t index : mesh.indices)
+    {
+        if (misses - loadedAt[index] >= cacheSize)
+            loadedAt[index] = misses++;
+    }
+    stats.acmr = double(misses) / (mesh.indices.size() / 3);
+    stats.atvr = double(misses) / mesh.VertexCount();
+    return stats;
+}
+
+// reorders the triangles for the post-transform cache
+inline void OptimizeVertexCache(IndexedMesh& mesh)
+{
+    using namespace mesh_optimizer;
+    const size_t vertexCount = mesh.VertexCount();
+    const size_t triangleCount = mesh.indices.size() / 3;
+
+    // Triangles not yet emitted of each vertex, adjacency[offsets[v]] to adjacency[offsets[v] + remaining[v]]
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t index : mesh.indices)
+        offsets[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(mesh.indices.size());
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = mesh.indices[t * 3 + k];
+            adjacency[offsets[v] + remaining[v]++] = static_cast<uint32_t>(t);
+        }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    int64_t best = -1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const uint32_t* triangle = &mesh.indices[t * 3];
+        triangleScore[t] = vertexScore[triangle[0]] + vertexScore[triangle[1]] + vertexScore[triangle[2]];
+        if (best < 0 || triangleScore[t] > triangleScore[best])
+            best = static_cast<int64_t>(t);
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(mesh.indices.size());
+    uint32_t cache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t nextUnemitted = 0;
+    while (output.size() < mesh.indices.size())
+    {
+        // Nothing in the cache has triangles left, continue with the first triangle not emitted yet
+        if (best < 0)
+        {
+            while (emitted[nextUnemitted])
+                nextUnemitted++;
+            best = static_cast<int64_t>(nextUnemitted);
+        }
+
+        const uint32_t* triangle = &mesh.indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = triangle[k];
+            uint32_t* first = &adjacency[offsets[v]];
+            uint32_t* last = first + remaining[v];
+            uint32_t* found = std::find(first, last, static_cast<uint32_t>(best));
+            if (found != last)
+            {
+                std::swap(*found, *(last - 1));
+                remaining[v]--;
+            }
+        }
+
+        // The triangle's vertices move to the front of the cache, pushing the others back
+        uint32_t newCache[CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; k++)
+            if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+                newCache[newCount++] = triangle[k];
+        for (int i = 0; i < cacheCount; i++)
+            if (std::find(triangle, triangle + 3, cache[i]) == triangle + 3)
+                newCache[newCount++] = cache[i];
+
+        for (int i = 0; i < newCount; i++)
+        {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < CACHE_SIZE ? i : -1;     // Vertices pushed past the end leave the cache
+            vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+        }
+        cacheCount = std::min(newCount, CACHE_SIZE);
+        for (int i = 0; i < cacheCount; i++)
+            cache[i] = newCache[i];
+
+        // Only triangles around vertices whose score changed can have changed, pick the best of them
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCount; i++)
+        {
+            uint32_t v = newCache[i];
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+            {
+                uint32_t t = adjacency[a];
+                const uint32_t* other = &mesh.indices[t * 3];
+                triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    mesh.indices.swap(output);
+}
+
+// splits the triangle order into clusters and sorts them so the ones facing away from the mesh centre (likely to be in
+// front of the others) are drawn first. Run after OptimizeVertexCache. Clusters start where the cache starts over and
+// wherever the miss rate since the cluster began has fallen to threshold times that of the whole run it is in, so
+// restarting the cache at every cluster costs at most about threshold times the ACMR
+inline void OptimizeOverdraw(IndexedMesh& mesh, float threshold = 1.05f, int cacheSize = 16)
+{
+    const size_t triangleCount = mesh.indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    auto position = [&mesh](uint32_t index) { return &mesh.vertices[static_cast<size_t>(index) * mesh.floatsPerVertex]; };
+
+    // FIFO cache simulation, a vertex is cached while fewer than cacheSize misses have happened since it was loaded
+    std::vector<int64_t> loadedAt(mesh.VertexCount(), INT64_MIN / 2);
+    int64_t misses = 0;
+    auto triangleMisses = [&](size_t t)
+    {
+        int count = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t index = mesh.indices[t * 3 + k];
+            if (misses - loadedAt[index] >= cacheSize)
+            {
+                loadedAt[index] = misses++;
+                count++;
+            }
+        }
+        return count;
+    };
+    auto resetCache = [&]() { misses += cacheSize; };
+
+    // Hard boundaries: triangles whose three vertices all miss
+    std::vector<size_t> hardStarts;
+    for (size_t t = 0; t < triangleCount; t++)
+        if (triangleMisses(t) == 3 || t == 0)
+            hardStarts.push_back(t);
+    hardStarts.push_back(triangleCount);
+
+    // Soft boundaries inside each run between hard boundaries
+    std::vector<size_t> clusterStarts;
+    for (size_t run = 0; run + 1 < hardStarts.size(); run++)
+    {
+        const size_t runStart = hardStarts[run], runEnd = hardStarts[run + 1];
+        resetCache();
+        int64_t runMisses = 0;
+        for (size_t t = runStart; t < runEnd; t++)
+            runMisses += triangleMisses(t);
+        const double runAcmr = double(runMisses) / (runEnd - runStart);
+
+        resetCache();
+        size_t clusterStart = runStart;
+        int64_t clusterMisses = 0;
+        clusterStarts.push_back(runStart);
+        for (size_t t = runStart; t < runEnd; t++)
+        {
+            clusterMisses += triangleMisses(t);
+            if (t + 1 < runEnd && double(clusterMisses) / (t + 1 - clusterStart) <= threshold * runAcmr)
+            {
+                clusterStarts.push_back(t + 1);
+                clusterStart = t + 1;
+                clusterMisses = 0;
+                resetCache();
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // Area weighted centroid and normal of every cluster and of the whole mesh
+    struct Cluster
+    {
+        size_t first;
+        size_t count;
+        double centroid[3];
+        double normal[3];
+        double area;
+        double sortKey;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size() - 1);
+    double meshCentroid[3] = {};
+    double meshArea = 0.0;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        Cluster& cluster = clusters[c];
+        cluster = { clusterStarts[c], clusterStarts[c + 1] - clusterStarts[c], {}, {}, 0.0, 0.0 };
+        for (size_t t = cluster.first; t < cluster.first + cluster.count; t++)
+        {
+            const float* a = position(mesh.indices[t * 3]);
+            const float* b = position(mesh.indices[t * 3 + 1]);
+            const float* p = position(mesh.indices[t * 3 + 2]);
+            double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            double ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+            double cross[3] = { ab[1] * ap[2] - ab[2] * ap[1], ab[2] * ap[0] - ab[0] * ap[2], ab[0] * ap[1] - ab[1] * ap[0] };
+            double area = 0.5 * std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+            for (int i = 0; i < 3; i++)
+            {
+                cluster.centroid[i] += area * (a[i] + b[i] + p[i]) / 3.0;
+                cluster.normal[i] += cross[i];
+            }
+            cluster.area += area;
+        }
+        for (int i = 0; i < 3; i++)
+            meshCentroid[i] += cluster.centroid[i];
+        meshArea += cluster.area;
+        if (cluster.area > 0.0)
+            for (int i = 0; i < 3; i++)
+                cluster.centroid[i] /= cluster.area;
+    }
+    if (meshArea > 0.0)
+        for (int i = 0; i < 3; i++)
+            meshCentroid[i] /= meshArea;
+
+    for (Cluster& cluster : clusters)
+    {
+        double length = std::sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+        for (int i = 0; i < 3; i++)
+            cluster.sortKey += (cluster.centroid[i] - meshCentroid[i]) * (length > 0.0 ? cluster.normal[i] / length : 0.0);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(mesh.indices.size());
+    for (const Cluster& cluster : clusters)
+        output.insert(output.end(), mesh.indices.begin() + cluster.first * 3, mesh.indices.begin() + (cluster.first + cluster.count) * 3);
+    mesh.indices.swap(output);
+}
+
+// renumbers the vertices in the order the triangles first use them, so vertex fetches walk the buffer forwards. Vertices
+// no triangle uses are dropped
+inline void OptimizeVertexFetch(IndexedMesh& mesh)
+{
+    std::vector<uint32_t> remap(mesh.VertexCount(), UINT32_MAX);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    uint32_t next = 0;
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = next++;
+            const float* vertex = &mesh.vertices[static_cast<size_t>(index) * mesh.floatsPerVertex];
+            vertices.insert(vertices.end(), vertex, vertex + mesh.floatsPerVertex);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+// runs every optimization in the order they depend on each other
+inline void OptimizeMesh(IndexedMesh& mesh)
+{
+    OptimizeVertexCache(mesh);
+    OptimizeOverdraw(mesh);
+    OptimizeVertexFetch(mesh);
+}
+#endif
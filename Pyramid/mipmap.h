@@ -0,0 +1,431 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Kernels use the widest instruction set the compiler targets (AVX2 with PYRAMID_NATIVE on a recent x86 CPU, SSE2 on
+// any x86-64 build, NEON on ARM) and fall back to plain loops otherwise
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIPMAP_AVX2
+#define MIPMAP_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPMAP_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIPMAP_NEON
+#endif
+
+// Builds mip chains on the CPU so they are the same on every driver and can be made on the texture loader threads. Each
+// level halves the one above it with a separable filter: a 2x2 box, or an 8 tap Kaiser windowed sinc that keeps more
+// detail without aliasing. Color channels are averaged as linear light when the image is sRGB encoded, otherwise dark
+// and bright texels averaged in gamma space darken every level; alpha is always averaged as it is
+
+enum class MipFilter
+{
+    Box,
+    Kaiser
+};
+
+// One mip level, tightly packed rows of channels bytes per texel
+struct MipLevel
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+namespace mipmap
+{
+    const int MAX_TAPS = 8;
+    const int PAD_LEFT = 3;             // Texels repeated before and after decoded rows for the Kaiser taps
+    const int PAD_RIGHT = 5;
+    const int ENCODE_TABLE_SIZE = 4096;
+
+    inline float SrgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    inline float LinearToSrgb(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Conversion tables shared by every thread, built on first use
+    struct Tables
+    {
+        float srgbToLinear[256];
+        float unormToFloat[256];
+        unsigned char linearToSrgb[ENCODE_TABLE_SIZE];  // Indexed by linear value * (ENCODE_TABLE_SIZE - 1)
+        float srgbThresholds[256];                      // Smallest linear value LinearToSrgb rounds to each texel value
+        float kaiser[MAX_TAPS];                         // Weights of source texels 2x-3 to 2x+4 for destination x
+        float box[2];
+
+        Tables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                srgbToLinear[i] = SrgbToLinear(i / 255.0f);
+                unormToFloat[i] = i / 255.0f;
+            }
+            for (int i = 0; i < ENCODE_TABLE_SIZE; i++)
+                linearToSrgb[i] = static_cast<unsigned char>(LinearToSrgb(i / float(ENCODE_TABLE_SIZE - 1)) * 255.0f + 0.5f);
+
+            // Bisect the bit patterns of positive floats, which are ordered like their values, for each threshold
+            auto encode = [](float value) { return static_cast<int>(LinearToSrgb(value) * 255.0f + 0.5f); };
+            srgbThresholds[0] = 0.0f;
+            for (int texel = 1; texel < 256; texel++)
+            {
+                uint32_t low = 0, high = 0x3F800000;    // Bit patterns of 0 and 1
+                while (low < high)
+                {
+                    uint32_t middle = low + (high - low) / 2;
+                    float value;
+                    memcpy(&value, &middle, sizeof(value));
+                    if (encode(value) >= texel)
+                        high = middle;
+                    else
+                        low = middle + 1;
+                }
+                memcpy(&srgbThresholds[texel], &low, sizeof(float));
+            }
+
+            // sinc(x) * I0(beta * sqrt(1 - (x / radius)^2)) / I0(beta) with x in destination texels, radius 2, beta 4
+            auto besselI0 = [](double x)
+            {
+                double sum = 1.0, term = 1.0;
+                for (int k = 1; k < 20; k++)
+                {
+                    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                    sum += term;
+                }
+                return sum;
+            };
+            const double pi = 3.14159265358979323846, radius = 2.0, beta = 4.0;
+            double total = 0.0;
+            for (int t = 0; t < MAX_TAPS; t++)
+            {
+                double x = (t - 3.5) / 2.0;     // Texel centres 2x-3 to 2x+4 around the destination centre 2x+1
+                double sinc = std::sin(pi * x) / (pi * x);
+                double window = besselI0(beta * std::sqrt(1.0 - (x / radius) * (x / radius))) / besselI0(beta);
+                kaiser[t] = static_cast<float>(sinc * window);
+                total += kaiser[t];
+            }
+            for (float& weight : kaiser)
+                weight = static_cast<float>(weight / total);
+            box[0] = box[1] = 0.5f;
+        }
+    };
+
+    inline const Tables& GetTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // converts a row to linear RGBA floats, repeating the edge texels PAD_LEFT and PAD_RIGHT times
+    inline void DecodeRow(const unsigned char* source, int width, int channels, const float* toLinear, float* row)
+    {
+        const float* unorm = GetTables().unormToFloat;
+        for (int x = -PAD_LEFT; x < width + PAD_RIGHT; x++)
+        {
+            const unsigned char* texel = source + std::min(std::max(x, 0), width - 1) * channels;
+            float* out = row + (x + PAD_LEFT) * 4;
+            out[0] = toLinear[texel[0]];
+            out[1] = toLinear[texel[1]];
+            out[2] = toLinear[texel[2]];
+            out[3] = channels == 4 ? unorm[texel[3]] : 1.0f;
+        }
+    }
+
+    // averages horizontal pairs of RGBA texels
+    inline void BoxHorizontal(const float* row, float* out, int width)
+    {
+        int x = 0;
+#if defined(MIPMAP_AVX2)
+        const __m256 half8 = _mm256_set1_ps(0.5f);
+        for (; x + 2 <= width; x += 2)
+        {
+            __m256 a = _mm256_loadu_ps(row + x * 8);        // Texels 2x, 2x+1
+            __m256 b = _mm256_loadu_ps(row + x * 8 + 8);    // Texels 2x+2, 2x+3
+            __m256 even = _mm256_permute2f128_ps(a, b, 0x20);
+            __m256 odd = _mm256_permute2f128_ps(a, b, 0x31);
+            _mm256_storeu_ps(out + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), half8));
+        }
+#endif
+#if defined(MIPMAP_SSE2)
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; x < width; x++)
+            _mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(row + x * 8), _mm_loadu_ps(row + x * 8 + 4)), half));
+#elif defined(MIPMAP_NEON)
+        for (; x < width; x++)
+            vst1q_f32(out + x * 4, vmulq_n_f32(vaddq_f32(vld1q_f32(row + x * 8), vld1q_f32(row + x * 8 + 4)), 0.5f));
+#else
+        for (; x < width; x++)
+            for (int c = 0; c < 4; c++)
+                out[x * 4 + c] = (row[x * 8 + c] + row[x * 8 + 4 + c]) * 0.5f;
+#endif
+    }
+
+    // filters RGBA texels 2x-3 to 2x+4 of a row (row points at texel -3) into each destination texel x
+    inline void KaiserHorizontal(const float* row, float* out, int width, const float* weights)
+    {
+        int x = 0;
+#if defined(MIPMAP_AVX2)
+        for (; x + 2 <= width; x += 2)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int t = 0; t < MAX_TAPS; t++)
+            {
+                __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(row + (x * 2 + t) * 4)),
+                    _mm_loadu_ps(row + (x * 2 + 2 + t) * 4), 1);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(texels, _mm256_set1_ps(weights[t])));
+            }
+            _mm256_storeu_ps(out + x * 4, sum);
+        }
+#endif
+#if defined(MIPMAP_SSE2)
+        for (; x < width; x++)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < MAX_TAPS; t++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + (x * 2 + t) * 4), _mm_set1_ps(weights[t])));
+            _mm_storeu_ps(out + x * 4, sum);
+        }
+#elif defined(MIPMAP_NEON)
+        for (; x < width; x++)
+        {
+            float32x4_t sum = vdupq_n_f32(0.0f);
+            for (int t = 0; t < MAX_TAPS; t++)
+                sum = vmlaq_n_f32(sum, vld1q_f32(row + (x * 2 + t) * 4), weights[t]);
+            vst1q_f32(out + x * 4, sum);
+        }
+#else
+        for (; x < width; x++)
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (int t = 0; t < MAX_TAPS; t++)
+                    sum += row[(x * 2 + t) * 4 + c] * weights[t];
+                out[x * 4 + c] = sum;
+            }
+#endif
+    }
+
+    // sums count horizontally filtered rows of floats with the given weights
+    inline void Vertical(const float* const* rows, const float* weights, int taps, float* out, int floats)
+    {
+        int i = 0;
+#if defined(MIPMAP_AVX2)
+        for (; i + 8 <= floats; i += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int t = 0; t < taps; t++)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[t] + i), _mm256_set1_ps(weights[t])));
+            _mm256_storeu_ps(out + i, sum);
+        }
+#endif
+#if defined(MIPMAP_SSE2)
+        for (; i < floats; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < taps; t++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[t] + i), _mm_set1_ps(weights[t])));
+            _mm_storeu_ps(out + i, sum);
+        }
+#elif defined(MIPMAP_NEON)
+        for (; i < floats; i += 4)
+        {
+            float32x4_t sum = vdupq_n_f32(0.0f);
+            for (int t = 0; t < taps; t++)
+                sum = vmlaq_n_f32(sum, vld1q_f32(rows[t] + i), weights[t]);
+            vst1q_f32(out + i, sum);
+        }
+#else
+        for (; i < floats; i++)
+        {
+            float sum = 0.0f;
+            for (int t = 0; t < taps; t++)
+                sum += rows[t][i] * weights[t];
+            out[i] = sum;
+        }
+#endif
+    }
+
+    // converts linear RGBA floats back to texels, sRGB encoding the color channels if srgb is set
+    inline void EncodeRow(const float* row, int width, int channels, bool srgb, unsigned char* out)
+    {
+        const unsigned char* toSrgb = GetTables().linearToSrgb;
+        const float* thresholds = GetTables().srgbThresholds;
+        const float colorScale = srgb ? ENCODE_TABLE_SIZE - 1.0f : 255.0f;
+        for (int x = 0; x < width; x++)
+        {
+            int values[4];
+#if defined(MIPMAP_SSE2)
+            __m128 texel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(row + x * 4), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128 scaled = _mm_add_ps(_mm_mul_ps(texel, _mm_setr_ps(colorScale, colorScale, colorScale, 255.0f)), _mm_set1_ps(0.5f));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_cvttps_epi32(scaled));
+#elif defined(MIPMAP_NEON)
+            const float scale[4] = { colorScale, colorScale, colorScale, 255.0f };
+            float32x4_t texel = vminq_f32(vmaxq_f32(vld1q_f32(row + x * 4), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+            vst1q_s32(values, vcvtq_s32_f32(vaddq_f32(vmulq_f32(texel, vld1q_f32(scale)), vdupq_n_f32(0.5f))));
+#else
+            for (int c = 0; c < 4; c++)
+                values[c] = static_cast<int>(std::min(std::max(row[x * 4 + c], 0.0f), 1.0f) * (c < 3 ? colorScale : 255.0f) + 0.5f);
+#endif
+            unsigned char* texel8 = out + x * channels;
+            for (int c = 0; c < 3; c++)
+            {
+                if (srgb)
+                {
+                    // The table is too coarse in the steep dark end, step to the texel whose threshold range holds
+                    // the value so the result matches LinearToSrgb rounded
+                    const float linear = std::min(std::max(row[x * 4 + c], 0.0f), 1.0f);
+                    int texel = toSrgb[values[c]];
+                    while (texel > 0 && linear < thresholds[texel])
+                        texel--;
+                    while (texel < 255 && linear >= thresholds[texel + 1])
+                        texel++;
+                    texel8[c] = static_cast<unsigned char>(texel);
+                }
+                else
+                    texel8[c] = static_cast<unsigned char>(values[c]);
+            }
+            if (channels == 4)
+                texel8[3] = static_cast<unsigned char>(values[3]);
+        }
+    }
+}
+
+// returns the instruction set the mip kernels were compiled for
+inline const char* MipSimdName()
+{
+#if defined(MIPMAP_AVX2)
+    return "AVX2";
+#elif defined(MIPMAP_SSE2)
+    return "SSE2";
+#elif defined(MIPMAP_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+// halves an RGB or RGBA image (odd sizes round down, 1 stays 1), repeating the edge texels under the filter
+inline MipLevel DownsampleLevel(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, bool srgb)
+{
+    using namespace mipmap;
+    const Tables& tables = GetTables();
+    const bool box = filter == MipFilter::Box;
+    const int taps = box ? 2 : MAX_TAPS;
+    const int firstTap = box ? 0 : -3;
+    const float* weights = box ? tables.box : tables.kaiser;
+
+    MipLevel level = { std::max(width / 2, 1), std::max(height / 2, 1), {} };
+    level.pixels.resize(static_cast<size_t>(level.width) * level.height * channels);
+    const size_t levelRowFloats = static_cast<size_t>(level.width) * 4;
+
+    // Horizontally filtered source rows are kept in slot row % taps, so neighbouring output rows reuse them
+    std::vector<float> decoded(static_cast<size_t>(width + PAD_LEFT + PAD_RIGHT) * 4);
+    std::vector<float> window(taps * levelRowFloats);
+    std::vector<float> filtered(levelRowFloats);
+    int windowRows[MAX_TAPS];
+    std::fill(windowRows, windowRows + MAX_TAPS, -1);
+
+    for (int y = 0; y < level.height; y++)
+    {
+        const float* rows[MAX_TAPS];
+        for (int t = 0; t < taps; t++)
+        {
+            int sourceRow = std::min(std::max(y * 2 + firstTap + t, 0), height - 1);
+            int slot = sourceRow % taps;
+            float* slotRow = window.data() + slot * levelRowFloats;
+            if (windowRows[slot] != sourceRow)
+            {
+                DecodeRow(pixels + static_cast<size_t>(sourceRow) * width * channels, width, channels,
+                    srgb ? tables.srgbToLinear : tables.unormToFloat, decoded.data());
+                if (box)
+                    BoxHorizontal(decoded.data() + PAD_LEFT * 4, slotRow, level.width);
+                else
+                    KaiserHorizontal(decoded.data(), slotRow, level.width, weights);
+                windowRows[slot] = sourceRow;
+            }
+            rows[t] = slotRow;
+        }
+        Vertical(rows, weights, taps, filtered.data(), static_cast<int>(levelRowFloats));
+        EncodeRow(filtered.data(), level.width, channels, srgb, level.pixels.data() + static_cast<size_t>(y) * level.width * channels);
+    }
+    return level;
+}
+
+// builds every level below an image down to 1x1, each from the one above it
+inline std::vector<MipLevel> GenerateMipChain(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, bool srgb)
+{
+    std::vector<MipLevel> levels;
+    while (width > 1 || height > 1)
+    {
+        levels.push_back(DownsampleLevel(pixels, width, height, channels, filter, srgb));
+        pixels = levels.back().pixels.data();
+        width = levels.back().width;
+        height = levels.back().height;
+    }
+    return levels;
+}
+
+// Straightforward per texel version of the same filters with exact sRGB conversions, to check the kernels against and
+// to measure them by
+namespace mipmap_reference
+{
+    inline MipLevel DownsampleLevel(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, bool srgb)
+    {
+        const mipmap::Tables& tables = mipmap::GetTables();
+        const bool box = filter == MipFilter::Box;
+        const int taps = box ? 2 : mipmap::MAX_TAPS;
+        const int firstTap = box ? 0 : -3;
+        const float* weights = box ? tables.box : tables.kaiser;
+
+        MipLevel level = { std::max(width / 2, 1), std::max(height / 2, 1), {} };
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * channels);
+        for (int y = 0; y < level.height; y++)
+            for (int x = 0; x < level.width; x++)
+                for (int c = 0; c < channels; c++)
+                {
+                    const bool color = srgb && c < 3;
+                    float sum = 0.0f;
+                    for (int ty = 0; ty < taps; ty++)
+                    {
+                        int sourceY = std::min(std::max(y * 2 + firstTap + ty, 0), height - 1);
+                        for (int tx = 0; tx < taps; tx++)
+                        {
+                            int sourceX = std::min(std::max(x * 2 + firstTap + tx, 0), width - 1);
+                            float value = pixels[(static_cast<size_t>(sourceY) * width + sourceX) * channels + c] / 255.0f;
+                            sum += weights[ty] * weights[tx] * (color ? mipmap::SrgbToLinear(value) : value);
+                        }
+                    }
+                    sum = std::min(std::max(sum, 0.0f), 1.0f);
+                    float encoded = color ? mipmap::LinearToSrgb(sum) : sum;
+                    level.pixels[(static_cast<size_t>(y) * level.width + x) * channels + c] = static_cast<unsigned char>(encoded * 255.0f + 0.5f);
+                }
+        return level;
+    }
+
+    inline std::vector<MipLevel> GenerateMipChain(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, bool srgb)
+    {
+        std::vector<MipLevel> levels;
+        while (width > 1 || height > 1)
+        {
+            levels.push_back(mipmap_reference::DownsampleLevel(pixels, width, height, channels, filter, srgb));
+            pixels = levels.back().pixels.data();
+            width = levels.back().width;
+            height = levels.back().height;
+        }
+        return levels;
+    }
+}
+#endif
@@ -5,260 +5,239 @@ W : Move forward        Q : Move down
 S : Move back           E : Moe up
 A : Move left           K : Stop orbiting
 D : Move right          L : Start Orbiting
+C : Toggle clustered lighting
+G : Toggle deferred shading
+P : Toggle the profiler (prints a per-stage CPU/GPU time table every second)
+I : Toggle instanced drawing (one draw call for all pyramids and one for all lamps)
+F : Toggle frustum culling
+U : Toggle GPU-driven culling and drawing (compute shader culling, one indirect multi-draw call)
 
 Scroling the mouse will zoom in.
 
+Command line options:
+--light-sweep           Time naive and clustered lighting with 2 to 1024 lights and exit
+--validate-clusters     Compare the GPU cluster light lists with the CPU reference and exit
+--deferred              Start with deferred shading
+--compare-render-modes  Render a frame forward and deferred offscreen, compare the pixels and exit
+--headless              Render offscreen without a window (EGL when built with PYRAMID_EGL)
+--frames N              Number of frames to render in headless mode (default 1)
+--output FILE           Write the last headless frame to a PPM image
+--benchmark N           Render N frames with a fixed timestep, report frame time percentiles and exit
+--timestep SECONDS      Simulated time per benchmark frame (default 1/60)
+--benchmark-output FILE Write benchmark results as JSON, or CSV if FILE ends in .csv
+--profile               Start with the profiler enabled
+--profile-trace FILE    Record every profiled stage and write a Chrome trace on exit
+--pyramids N            Render N pyramids on a grid instead of one
+--shader-cache DIR      Cache linked shader programs in DIR (default shader_cache)
+--no-shader-cache       Always compile shader programs from source
+--stress                Time 100k pyramids drawn instanced and with one draw call each, and exit
+--upload-benchmark      Compare texture upload MB/s from client memory and through the PBO upload ring, and exit
+--texture-load          Load the texture 8 times at once, report the time and peak RSS, and exit
+--mip-benchmark         Compare CPU mip generation Mpixels/s with the scalar reference and glGenerateMipmap, and exit
+--mesh-benchmark        Report ACMR/ATVR of a shuffled sphere after each mesh optimization step, and exit
+--orbit-benchmark       Time the orbit of 1M lights with the interleaved glm path and the SoA kernels, and exit
+--culling-benchmark     Time frustum culling of 10k to 1M pyramids with the bounding volume tree, and exit
+--no-culling            Draw every pyramid and lamp instead of only the ones inside the view frustum
+--gpu-culling           Start with the pyramids culled in a compute shader and drawn with one indirect multi-draw call
+--no-mmap               Read texture files with stdio instead of memory mapping them
+--float-vertices        Upload 32 byte float vertices instead of the 16 byte quantized format
+--software              Render --frames frames on the CPU without a GPU or window, report Mtris/s and Mpix/s, save
+                        the last one with --output and exit
+
 */
 
+
 #include <iostream>         // Allow for input/output
 #include <cstdlib>          // EXIT_FAILURE
+#include <atomic>           // Allocation counter
+#include <new>              // Replaceable operator new/delete
+#include <cstring>          // Command line parsing
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 
-// GLM Libraries
-#include <glm/glm.hpp>
-#include <glm/gtx/transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-// STB Library to load an image
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#include <string>
-
-#include "camera.h" // Camera class
+#include "renderer.h" // Scene, shaders and render functions
+#include "headless.h" // Windowless OpenGL context
 
 using namespace std; 
 
-// Shader program Macro
-#ifndef GLSL
-#define GLSL(Version, Source) "#version " #Version " core \n" #Source
-#endif
-
 namespace
 {
     // Set window title
     const char* const WINDOW_TITLE = "6-3 Assignment: Lighting a Pyramid By Paul K."; 
 
-    // window variables
-    const int WINDOW_WIDTH = 800;
-    const int WINDOW_HEIGHT = 600;
+    // Context used instead of a window in headless mode
+    HeadlessContext gHeadlessContext;
 
-    // Store mesh data
-    struct GLMesh
-    {
-        GLuint vao;         // Handle for vertex array object
-        GLuint vbo;         // Handle for  vertex buffer object
-        GLuint nVertices;   // Number of indices of the mesh
-    };
-
-    // Store light data
-    class GLLight
-    {
-    public:
-        GLuint shaderProgram;     // Handle for shader program
-        glm::vec3 lightPosition;  // Position of light in 3Dscene
-        glm::vec3 lightScale;     // Scale of light 
-        glm::vec3 lightColor;     // Color of light
-        float lightIntensity;     // Light intensity
-    };
-
-    // Declare new window object
-    GLFWwindow* gWindow = nullptr;
-    // Triangle mesh data
-    GLMesh gMesh;
-    // Texture and scale
-    GLuint gTextureId;
-    glm::vec2 gUVScale(1.0f, 1.0f);
-
-    // Vector to hold light data that is passed to CalcPointLight
-    vector<GLLight> gSceneLights{
-        { 0, glm::vec3(2.0f, 0.5f, 1.0f), glm::vec3(0.3f), glm::vec3(0.1f, 0.8f, 0.1f), 1.0f}, // Greenish Key light 100% intensity
-        { 0, glm::vec3(-3.0f, 2.0f, 1.0f), glm::vec3(0.3f), glm::vec3(0.1f, 0.1f, 0.8f), 0.1f},  //Fill light 10% intensity 
-    }; 
-
-    // Decalre Shader program object
-    GLuint shaderProgramId;
-
-    // Define camera position
-    Camera gCamera(glm::vec3(0.0f, 0.5f, 7.0f));
+    // Heap allocations made by the program, used to verify the render loop does not allocate
+    std::atomic<size_t> gAllocationCount(0);
 
     // Variables to ensure application runs the same on all hardware
     float gLastX = WINDOW_WIDTH / 2.0f;
     float gLastY = WINDOW_HEIGHT / 2.0f;
-    float gDeltaTime = 0.0f;
     float gLastFrame = 0.0f;
 
     bool gFirstMouse = true;    // Detect initial mouse movement
-
-    // Pyramid position and scale
-    glm::vec3 pyramidPosition(0.0f, 0.0f, 0.0f);
-    glm::vec3 pyramidScale(1.0f);
-
-    // Orbit lights around scene / pyramid
-    bool gIsLampOrbiting = true;
 }
 
     // Input fucntions 
     bool UInitialize(int, char* [], GLFWwindow** window);
+    bool UInitializeHeadless();
     void UResizeWindow(GLFWwindow* window, int width, int height);
     void UProcessInput(GLFWwindow* window);
     void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
     void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
-    // Functions to create, compile, destroy the shader program, create and render primitives
-    void UCreateMesh(GLMesh& mesh);
-    void UDestroyMesh(GLMesh& mesh);
-    bool UCreateTexture(const char* filename, GLuint& textureId);
-    void UDestroyTexture(GLuint textureId);
-    void URender();
-    bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
-    void UDestroyShaderProgram(GLuint programId);
-
-// Vertex Shader Source Code
-const GLchar* vertexShaderSource = GLSL(440,
-    // Declare attribute locations
-    layout(location = 0) in vec3 position;          // Vertex position 
-    layout(location = 1) in vec3 normal;            // Normals
-    layout(location = 2) in vec2 textureCoordinate; // Textures
-
-    out vec3 vertexNormal;              // Outgoing normals to fragment shader
-    out vec3 vertexFragmentPos;         // Outgoing color / pixels to fragment shader
-    out vec2 vertexTextureCoordinate;   // Outgoing texture to fragment shader
-
-    // Uniform/Global variables for transform matrices
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
-
-void main()
+int main(int argc, char* argv[])
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transform vertices to clip coordinates
-
-    vertexFragmentPos = vec3(model * vec4(position, 1.0f));         // Get fragment / pixel position into world space only
-
-    // Get normals in world space only (exclude normal translation properties)
-    vertexNormal = mat3(transpose(inverse(model))) * normal;        
-    vertexTextureCoordinate = textureCoordinate;
-}
-);
-
-// Fragment Shader Source Code
-const GLchar* fragmentShaderSource = GLSL(440,
-
-    in vec3 vertexNormal;              // Incoming normals
-    in vec3 vertexFragmentPos;         // Incoming fragment position
-    in vec2 vertexTextureCoordinate;   // Incoming texture coordinates
-
-    out vec4 fragmentColor;             // Outgoing pyramid  color to GPU
-
-    // Uniform/Global variables for scene lights, view (camera) position, texture, and scale 
-    uniform vec3 lightColor1;           
-    uniform vec3 lightPos1;             // Light 1
-    uniform float lightIntensity1;
-    uniform vec3 lightColor2;
-    uniform vec3 lightPos2;             // Light 2
-    uniform float lightIntensity2;
-
-    uniform vec3 viewPosition;
-    uniform sampler2D uTexture; 
-    uniform vec2 uvScale;
-
-    /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
-    vec3 CalcPointLight(vec3 lightPos, vec3 lightColor, float lightIntensity, vec3 vertexFragmentPos, vec3 viewPosition)
+    // Headless options are needed before the context is created
+    bool headless = false;
+    bool software = false;
+    int headlessFrames = 1;
+    const char* outputFilename = nullptr;
+    float benchmarkTimestep = 1.0f / 60.0f;
+    const char* benchmarkFilename = nullptr;
+    bool profile = false;
+    const char* traceFilename = nullptr;
+    for (int i = 1; i < argc; i++)
     {
-        // Calculate Ambient lighting
-        vec3 ambient = lightIntensity * lightColor; 
-
-        // Calculate Diffuse lighting
-        vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-        vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance between light source and fragments/pixels
-        float impact = max(dot(norm, lightDirection), 0.2);// Calculate diffuse impact
-        vec3 diffuse = impact * lightColor;
-
-        // Calculate Specular lighting
-        float specularIntensity = 0.0f; // Set specular light strength
-        float highlightSize = 0.0f; // Set specular highlight size
-        vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
-        vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
-        float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-        vec3 specular = specularIntensity * specularComponent * lightColor;
-
-        // Calculate phong result
-         vec3 phong = (ambient + diffuse + specular);
-        // vec3 phong = (ambient + diffuse);
-        // vec3 phong = (ambient);
-
-        return phong;
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--software") == 0)
+            software = true;
+        else if (strcmp(argv[i], "--timestep") == 0 && i + 1 < argc)
+            benchmarkTimestep = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc)
+            benchmarkFilename = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0)
+            profile = true;
+        else if (strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc)
+            traceFilename = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            headlessFrames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputFilename = argv[++i];
+        else if (strcmp(argv[i], "--pyramids") == 0 && i + 1 < argc)
+            gPyramidCount = max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+            gShaderCacheDirectory = argv[++i];
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+            gShaderCacheDirectory = nullptr;
+        else if (strcmp(argv[i], "--no-mmap") == 0)
+            gMapTextureFiles = false;
+        else if (strcmp(argv[i], "--float-vertices") == 0)
+            gUseQuantizedVertices = false;
+        else if (strcmp(argv[i], "--no-culling") == 0)
+            gUseFrustumCulling = false;
+        else if (strcmp(argv[i], "--gpu-culling") == 0)
+            gUseGpuCulling = true;
     }
 
-void main()
-{
-    vec3 result = vec3(0.0);
-    vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);   // Pyramid texture / texture coordinates / scale
+    // The software renderer needs no context at all
+    if (software)
+        return URunSoftwareRenderer(headlessFrames, benchmarkTimestep, outputFilename) ? EXIT_SUCCESS : EXIT_FAILURE;
 
-    // Calculate Light 1 and Light 2
-    result += CalcPointLight(lightPos1, lightColor1, lightIntensity1, vertexFragmentPos, viewPosition) * textureColor.xyz;
-    result += CalcPointLight(lightPos2, lightColor2, lightIntensity2, vertexFragmentPos, viewPosition) * textureColor.xyz;
+    if (headless)
+    {
+        if (!UInitializeHeadless()) // Call function to create a windowless context and initialize GLEW
+            return EXIT_FAILURE;
+    }
+    else if (!UInitialize(argc, argv, &gWindow)) // Call function to initialize GLFW, GLEW, and create a window
+        return EXIT_FAILURE;
 
-    fragmentColor = vec4(result, 1.0); // Send results to GPU
-}
-);
-
-// Lamp vertex Shader Source Code
-const GLchar* lampVertexShaderSource = GLSL(440,
-    layout(location = 0) in vec3 position;  // Declare attribute locations
-    
-    // Uniform/Global variables for transform matrices
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices to clip coordinates
-}
-);
+    if (!UCreateRenderer()) // Call function to create the mesh, shader programs, texture and light buffers
+        return EXIT_FAILURE;
 
-// Lamp fragment Shader Source Code
-const GLchar* lampFragmentShaderSource = GLSL(440,
+    gProfiler.SetEnabled(profile || traceFilename != nullptr, traceFilename != nullptr);
 
-    out vec4 fragmentColor; 
+    // Headless frames are rendered into an offscreen framebuffer
+    RenderTarget headlessTarget;
+    if (headless)
+    {
+        if (!headlessTarget.Create(gFramebufferWidth, gFramebufferHeight))
+        {
+            cout << "Failed to create offscreen framebuffer" << endl;
+            return EXIT_FAILURE;
+        }
+        gTargetFramebuffer = headlessTarget.Framebuffer();
+        glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+    }
 
-void main()
-{
-    fragmentColor = vec4(1.0f); // Set color to white w/ alpha 1
-}
-);
+    // Run a benchmark or validation instead of the render loop when requested
+    bool ranTask = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--deferred") == 0)
+            gUseDeferredShading = true;
+        else if (strcmp(argv[i], "--compare-render-modes") == 0)
+        {
+            if (!UCompareRenderModes())
+                return EXIT_FAILURE;
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--light-sweep") == 0)
+        {
+            ULightSweepBenchmark();
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--stress") == 0)
+        {
+            UDrawCallBenchmark(100000);
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--upload-benchmark") == 0)
+        {
+            UTextureUploadBenchmark();
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--mesh-benchmark") == 0)
+        {
+            UMeshOptimizationBenchmark();
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--orbit-benchmark") == 0)
+        {
+            ULightOrbitBenchmark();
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--culling-benchmark") == 0)
+        {
+            UCullingBenchmark();
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--mip-benchmark") == 0)
+        {
+            UMipmapBenchmark();
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--texture-load") == 0)
+        {
+            UTextureLoadBenchmark(8);
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--validate-clusters") == 0)
+        {
+            if (!UValidateClusters())
+                return EXIT_FAILURE;
+            ranTask = true;
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+        {
+            if (!URunBenchmark(atoi(argv[++i]), benchmarkTimestep, benchmarkFilename))
+                return EXIT_FAILURE;
+            ranTask = true;
+        }
+    }
 
-int main(int argc, char* argv[])
-{
-    if (!UInitialize(argc, argv, &gWindow)) // Call function to initialize GLFW, GLEW, and create a window
+    if (headless && !ranTask && !URunHeadless(headlessTarget, headlessFrames, outputFilename))
         return EXIT_FAILURE;
 
-    UCreateMesh(gMesh); // Call function to create pyramid VBO/VAO
-
-    // Create fucntion to create shader programs - pyramid and lamp
-    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, shaderProgramId))
-        return EXIT_FAILURE;
-    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gSceneLights[0].shaderProgram))
-        return EXIT_FAILURE;
-    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gSceneLights[1].shaderProgram))
-        return EXIT_FAILURE;
-        
-    const char* texFilename = "brick.jpg";      
-    if (!UCreateTexture(texFilename, gTextureId))       // Call function to generate texture passing texture image file
-    {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
-    }
-   
-    glUseProgram(shaderProgramId);  // Set shader program
-    glUniform1i(glGetUniformLocation(shaderProgramId, "uTexture"), 0);  // Set texture as texture unit 0
-    
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // Set background color to black
+    // Count heap allocations made while rendering once the first frame is out of the way
+    size_t steadyStateFrames = 0;
+    size_t steadyStateAllocations = 0;
+    float lastProfileReport = 0.0f;
 
     // Render loop (infinite loop until user closes window)
-    while (!glfwWindowShouldClose(gWindow))
+    while (!headless && !ranTask && !glfwWindowShouldClose(gWindow))
     {
         // Set delta time and ensure we are transforming at consistent rate
         float currentFrame = glfwGetTime();     
@@ -267,18 +246,39 @@ int main(int argc, char* argv[])
 
         UProcessInput(gWindow); // Call fucntion to get input from user
 
+        size_t allocationsBefore = gAllocationCount;
         URender();              // Call function to render frame
+        if (steadyStateFrames++ > 0)
+            steadyStateAllocations += gAllocationCount - allocationsBefore;
+
+        // Print the profiler's rolling stage table once a second
+        if (gProfiler.Enabled() && currentFrame - lastProfileReport >= 1.0f)
+        {
+            gProfiler.PrintTable(cout);
+            cout << "Visible: " << gCullingStats.visibleObjects << " of " << gCullingStats.objects << " pyramids, "
+                 << gCullingStats.visibleLamps << " of " << gCullingStats.lamps << " lamps" << endl;
+            lastProfileReport = currentFrame;
+        }
 
         glfwPollEvents();       // Process events
     }
 
-    UDestroyMesh(gMesh);                    // Release mesh data
-    UDestroyTexture(gTextureId);            // Release texture data
-    UDestroyShaderProgram(shaderProgramId); // Release shader program for pyramid
-    for (const GLLight light : gSceneLights)
+    if (steadyStateFrames > 1)
+        cout << "Heap allocations in URender: " << steadyStateAllocations << " over " << steadyStateFrames - 1 << " steady-state frames" << endl;
+
+    if (gProfiler.Enabled())
+        gProfiler.PrintTable(cout);
+    if (traceFilename != nullptr)
     {
-        UDestroyShaderProgram(light.shaderProgram);  // Loop through vector to release shader program for lights
+        if (gProfiler.WriteChromeTrace(traceFilename))
+            cout << "Wrote " << traceFilename << endl;
+        else
+            cout << "Failed to write " << traceFilename << endl;
     }
+    headlessTarget.Destroy();               // Release offscreen framebuffer
+    UDestroyRenderer();                     // Release mesh, texture, shader programs and buffers
+    if (headless)
+        gHeadlessContext.Destroy();         // Release headless context
 
     exit(EXIT_SUCCESS); // Terminate the program successfully
 }
@@ -323,6 +323,12 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
     return true;
 }
 
+// Create a windowless context and initialize GLEW
+bool UInitializeHeadless()
+{
+    return gHeadlessContext.Create(4, 4);
+}
+
 // Function to process user keyboard input
 void UProcessInput(GLFWwindow* window)
 {
@@ -349,12 +355,71 @@ void UProcessInput(GLFWwindow* window)
         gIsLampOrbiting = true;
     else if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && gIsLampOrbiting)
         gIsLampOrbiting = false;
+
+    // Toggle the profiler once per key press
+    static bool isPKeyDown = false;
+    bool pKeyPressed = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (pKeyPressed && !isPKeyDown)
+        gProfiler.SetEnabled(!gProfiler.Enabled());
+    isPKeyDown = pKeyPressed;
+
+    // Toggle instanced drawing once per key press
+    static bool isIKeyDown = false;
+    bool iKeyPressed = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    if (iKeyPressed && !isIKeyDown)
+    {
+        gUseInstancing = !gUseInstancing;
+        cout << (gUseInstancing ? "Instanced" : "Per object") << " drawing" << endl;
+    }
+    isIKeyDown = iKeyPressed;
+
+    // Toggle deferred shading once per key press
+    static bool isGKeyDown = false;
+    bool gKeyPressed = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gKeyPressed && !isGKeyDown)
+    {
+        gUseDeferredShading = !gUseDeferredShading;
+        cout << (gUseDeferredShading ? "Deferred" : "Forward") << " shading" << endl;
+    }
+    isGKeyDown = gKeyPressed;
+
+    // Toggle clustered lighting once per key press
+    static bool isCKeyDown = false;
+    bool cKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cKeyPressed && !isCKeyDown)
+    {
+        gUseClusteredShading = !gUseClusteredShading;
+        cout << (gUseClusteredShading ? "Clustered" : "Naive") << " lighting" << endl;
+    }
+    isCKeyDown = cKeyPressed;
+
+    // Toggle frustum culling once per key press
+    static bool isFKeyDown = false;
+    bool fKeyPressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (fKeyPressed && !isFKeyDown)
+    {
+        gUseFrustumCulling = !gUseFrustumCulling;
+        cout << "Frustum culling " << (gUseFrustumCulling ? "on" : "off") << endl;
+    }
+    isFKeyDown = fKeyPressed;
+
+    // Toggle GPU-driven culling and drawing once per key press
+    static bool isUKeyDown = false;
+    bool uKeyPressed = glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS;
+    if (uKeyPressed && !isUKeyDown)
+    {
+        gUseGpuCulling = !gUseGpuCulling;
+        cout << (gUseGpuCulling ? "GPU" : "CPU") << " culling" << endl;
+    }
+    isUKeyDown = uKeyPressed;
 }
 
 // Fucntion to resize window and graphics simultaneously
 void UResizeWindow(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    gFramebufferWidth = width;
+    gFramebufferHeight = height;
 }
 
 // Function to process mouse movement
@@ -382,267 +447,26 @@ void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
     gCamera.ProcessMouseScroll(yoffset);
 }
 
-// Functioned called to render a frame
-void URender()
+// Replaceable allocation functions that count heap allocations
+void* operator new(size_t size)
 {
-    // Allow lights to orbit scene
-    const float angularVelocity = glm::radians(45.0f);
-    if (gIsLampOrbiting)
-    {
-        for (int i = 0; i < gSceneLights.size(); i++)
-        {
-            glm::vec4 newPosition = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(gSceneLights[i].lightPosition, 1.0f);
-            gSceneLights[i].lightPosition[0] = newPosition.x;
-            gSceneLights[i].lightPosition[1] = newPosition.y;
-            gSceneLights[i].lightPosition[2] = newPosition.z;
-        }
-    }
-
-    glEnable(GL_DEPTH_TEST);    // Allows for depth comparisons and to update the depth buffer
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // Clear the frame and z buffers
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glBindVertexArray(gMesh.vao);   // Activate the pyramid VAO (used by pyramid and lights)    
-    glUseProgram(shaderProgramId);  // Set the shader to be used
-
-    glm::mat4 rotation = glm::rotate(8.3f, glm::vec3(0.0, 1.0f, 0.0f)); // Rotate along y-axis
-
-    glm::mat4 model = glm::translate(pyramidPosition) * rotation * glm::scale(pyramidScale);  // Set model matrix
-
-    // Create view matrix that transforms all world coordinates to view space
-    glm::mat4 view = gCamera.GetViewMatrix();
-
-    // Create perspective projection
-    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
-    // Retrieve and pass transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(shaderProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgramId, "view");
-    GLint projLoc = glGetUniformLocation(shaderProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Draw Lights
-    for (int i = 0; i < gSceneLights.size(); i++)
-    {   // Retrieve and pass color position, and intensity data to the Shader program
-        GLint lightColorLoc = glGetUniformLocation(shaderProgramId, ("lightColor" + std::to_string(i + 1)).c_str());
-        GLint lightPositionLoc = glGetUniformLocation(shaderProgramId, ("lightPos" + std::to_string(i + 1)).c_str());
-        GLint lightIntensityLoc = glGetUniformLocation(shaderProgramId, ("lightIntensity" + std::to_string(i + 1)).c_str());
-    
-        glUniform3f(lightColorLoc, gSceneLights[i].lightColor[0], gSceneLights[i].lightColor[1], gSceneLights[i].lightColor[2]);
-        glUniform3f(lightPositionLoc, gSceneLights[i].lightPosition[0], gSceneLights[i].lightPosition[1], gSceneLights[i].lightPosition[2]);
-        glUniform1f(lightIntensityLoc, gSceneLights[i].lightIntensity);
-    }
-
-    // Pass camera and scale data to the Shader program
-    GLint viewPositionLoc = glGetUniformLocation(shaderProgramId, "viewPosition");
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    GLint UVScaleLoc = glGetUniformLocation(shaderProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    // Bind texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-
-    // Draw pyramid
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices);
-
-    // Draw lamps
-    for (int i = 0; i < gSceneLights.size(); i++) 
-    {
-        glUseProgram(gSceneLights[i].shaderProgram); // Activate shader program
-
-        // Transform lights
-        model = glm::translate(gSceneLights[i].lightPosition) * glm::scale(gSceneLights[i].lightScale);
-
-        // Select uniform shader and variable
-        modelLoc = glGetUniformLocation(gSceneLights[i].shaderProgram, "model");
-        viewLoc = glGetUniformLocation(gSceneLights[i].shaderProgram, "view");
-        projLoc = glGetUniformLocation(gSceneLights[i].shaderProgram, "projection");
-
-        // Pass matrix data to Lamp Shader program
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices); // Draws lamps 
-    }
-
-    // Deactivate VAO and shader program
-    glBindVertexArray(0);
-    glUseProgram(0);
-
-    glfwSwapBuffers(gWindow);    // Swap front and back buffers of window
-}
-
-// Function holds pyramid coordinates, generates/activates VAO/VBO, and create/enable Vertex Attribute Pointers
-void UCreateMesh(GLMesh& mesh)
-{
-    // Position and Color data
-    GLfloat verts[] = {
-       // Position (x, y, z)   // Normals (x, y, z)  // Texture (x, y)
-        -1.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,		0.0f, 0.0f,	    // Base Triangle 1 (bottom)
-        -1.0f, 0.0f,  1.0f,		0.0f, -1.0f, 0.0f,		0.0f, 1.0f,
-         1.0f, 0.0f,  1.0f,		0.0f, -1.0f, 0.0f,		1.0f, 1.0f,
-
-         1.0f, 0.0f,  1.0f,	    0.0f, -1.0f, 0.0f,		1.0f, 1.0f,	    // Base Triangle 2 (bottom)
-         1.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,		1.0f, 0.0f,
-        -1.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,		0.0f, 0.0f,
-
-        -1.0f, 0.0f, -1.0f,		-1.0f, 0.0f, 0.0f,		0.0f, 0.0f,    // Side 1 (left)
-        -1.0f, 0.0f,  1.0f,		-1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,	    -1.0f, 0.0f, 0.0f,		0.5f, 1.0f,
-
-        -1.0f, 0.0f, -1.0f,		0.0f, 0.0f, -1.0f,		0.0f, 0.0f,    // Side 2 (back)
-         1.0f, 0.0f, -1.0f,		0.0f, 0.0f, -1.0f,		1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,		0.0f, 0.0f, -1.0f,		0.5f, 1.0f,
-
-         1.0f, 0.0f,  1.0f,		1.0f, 0.0f, 0.0f,		0.0f, 0.0f,    // Side 3 (right)
-         1.0f, 0.0f, -1.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,		1.0f, 0.0f, 0.0f,		0.5f, 1.0f,
-
-        -1.0f, 0.0f, 1.0f,		0.0f, 0.0f, 1.0f,		0.0f, 0.0f,     // Side 4 (front)
-         1.0f, 0.0f, 1.0f,		0.0f, 0.0f, 1.0f,		1.0f, 0.0f,
-         0.0f, 1.0f, 0.0f,		0.0f, 0.0f, 1.0f, 		0.5f, 1.0f
-    };
-    // Identify how many floats for Position, Normal, and Texture coordinates
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
-
-    mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-    glGenVertexArrays(1, &mesh.vao); // Create and bind Vertex Array Object
-    glBindVertexArray(mesh.vao);
-
-    glGenBuffers(1, &mesh.vbo); // Create and activate Vertex Buffer Object
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Send vertex data to the GPU
-
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    // Create Vertex Attribute Pointers - position, normal, texture
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
-}
-
-// Function to destroy VAO and VBO
-void UDestroyMesh(GLMesh& mesh)
-{
-    glDeleteVertexArrays(1, &mesh.vao);
-    glDeleteBuffers(1, &mesh.vbo);
-}
-
-// Function to load and bind texture
-bool UCreateTexture(const char* filename, GLuint& textureId)
-{
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
-    {
-        stbi_set_flip_vertically_on_load(true); // Flip y-axis during image loading so that image is not upside down
-
-        glGenTextures(1, &textureId);               // Create texture ID
-        glBindTexture(GL_TEXTURE_2D, textureId);    // Bind texure 
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);       // Specify how to wrap texture
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);   // Specify how to filter texture
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        else
-        {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
-        }
-
-        glGenerateMipmap(GL_TEXTURE_2D);    // Generate all  required mipmaps for currently bound texture
-            
-        stbi_image_free(image);             // Free image memory
-        glBindTexture(GL_TEXTURE_2D, 0);    // Unbind the texture
-
-        return true;                        // Image loaded and texture bound successfully
-    }
-
-    return false;   // Error loading the image
+    gAllocationCount++;
+    if (void* memory = malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
 }
 
-// Function to destroy texture
-void UDestroyTexture(GLuint textureId)
+void* operator new[](size_t size)
 {
-    glGenTextures(1, &textureId);
+    return operator new(size);
 }
 
-// Function to create shader program
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+void operator delete(void* memory) noexcept
 {
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
-
-    // Create shader program object
-    programId = glCreateProgram();
-
-    // Create  vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Retrive shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
-
-    // Compile vertex shader, and print compilation errors
-    glCompileShader(vertexShaderId);
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return false;
-    }
-    // Compile fragment shader, and print compilation errors
-    glCompileShader(fragmentShaderId); 
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return false;
-    }
-
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
-
-    // Link shader program, and print linking errors
-    glLinkProgram(programId);
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-        return false;
-    }
-
-    glUseProgram(programId);    // Use shader program
-    return true;
+    free(memory);
 }
 
-// Function to destroy shader program
-void UDestroyShaderProgram(GLuint programId)
+void operator delete[](void* memory) noexcept
 {
-    glDeleteProgram(programId);
+    free(memory);
 }
@@ -0,0 +1,134 @@
+#ifndef PIXEL_UPLOAD_RING_H
+#define PIXEL_UPLOAD_RING_H
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+
+// A persistently mapped GL_PIXEL_UNPACK_BUFFER split into SEGMENT_COUNT segments used in turn. Pixels are written into
+// the current segment and the texture uploads read them from there with an offset; a fence placed after the uploads
+// guards the segment, so the CPU only waits if it wraps around to a segment the GPU is still reading. With three
+// segments the CPU can fill one while the GPU copies from the others
+class PixelUploadRing
+{
+public:
+    static const int SEGMENT_COUNT = 3;
+
+    // creates the buffer with segments of segmentBytes bytes, returns false if it cannot be mapped
+    bool Create(size_t segmentBytes)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        segmentSize = segmentBytes;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, segmentSize * SEGMENT_COUNT, nullptr, flags);
+        memory = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, segmentSize * SEGMENT_COUNT, flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (memory == nullptr)
+        {
+            Destroy();
+            return false;
+        }
+        return true;
+    }
+
+    // waits for the GPU to finish with every segment and releases the buffer
+    void Destroy()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence != nullptr)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        if (buffer != 0)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = 0;
+        memory = nullptr;
+        segmentSize = 0;
+    }
+
+    // moves to the next segment, waiting if the GPU is still reading it, and returns where to write its pixels. The
+    // buffer is bound to GL_PIXEL_UNPACK_BUFFER; upload from Offset() until End is called
+    unsigned char* Begin()
+    {
+        segment = (segment + 1) % SEGMENT_COUNT;
+        GLsync& fence = fences[segment];
+        if (fence != nullptr)
+        {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                stalls++;
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        return memory + Offset();
+    }
+
+    // fences the current segment after the uploads reading it have been issued and unbinds the buffer
+    void End()
+    {
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // returns the byte offset of the current segment, to pass as the pixel pointer of glTexSubImage2D
+    size_t Offset() const
+    {
+        return segment * segmentSize;
+    }
+
+    size_t SegmentSize() const
+    {
+        return segmentSize;
+    }
+
+    // returns the number of times Begin had to wait for the GPU
+    size_t Stalls() const
+    {
+        return stalls;
+    }
+
+private:
+    GLuint buffer = 0;
+    unsigned char* memory = nullptr;    // Mapped for the lifetime of the ring
+    size_t segmentSize = 0;
+    int segment = SEGMENT_COUNT - 1;
+    GLsync fences[SEGMENT_COUNT] = {};
+    size_t stalls = 0;
+};
+
+// Uploads a whole image into a mip level of the bound 2D texture through a ring, in bands of rows that fit in a segment
+// so images larger than a segment stream through the ring. The texture storage must already exist
+inline bool UploadThroughRing(PixelUploadRing& ring, const unsigned char* pixels, int width, int height, GLenum format, int bytesPerPixel, GLint level = 0)
+{
+    const size_t rowSize = static_cast<size_t>(width) * bytesPerPixel;
+    const int rowsPerBand = static_cast<int>(ring.SegmentSize() / rowSize);
+    if (rowsPerBand == 0)
+        return false;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // RGB rows are not padded to 4 bytes
+    for (int row = 0; row < height; row += rowsPerBand)
+    {
+        int rows = height - row < rowsPerBand ? height - row : rowsPerBand;
+        unsigned char* destination = ring.Begin();
+        std::copy(pixels + row * rowSize, pixels + (row + rows) * rowSize, destination);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, row, width, rows, format, GL_UNSIGNED_BYTE, (void*)ring.Offset());
+        ring.End();
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return true;
+}
+#endif
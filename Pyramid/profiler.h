@@ -0,0 +1,279 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measures named stages of a frame on the CPU and on the GPU. GPU time comes from GL_TIMESTAMP queries written into a
+// ring of FRAME_LATENCY frames; a frame's queries are read back when its ring slot comes round again, and only if the
+// GPU has already finished them, so profiling never waits on the GPU. Stage names must be string literals (or otherwise
+// outlive the profiler) because they are stored by pointer
+class Profiler
+{
+public:
+    static const int FRAME_LATENCY = 4;     // Frames of queries in flight
+    static const int MAX_SCOPES = 32;       // Scopes per frame
+    static const int MAX_STAGES = 32;       // Distinct stage names
+    static const int HISTORY = 60;          // Frames averaged in the stage table
+    static const size_t MAX_TRACE_EVENTS = 1 << 18;
+
+    // creates the query ring and records the GPU clock so GPU times can be placed on the CPU timeline
+    void Create()
+    {
+        glGenQueries(FRAME_LATENCY * MAX_SCOPES * 2, queries);
+        start = std::chrono::steady_clock::now();
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuStartNanoseconds = gpuNow;
+        created = true;
+    }
+
+    // releases the query ring
+    void Destroy()
+    {
+        if (created)
+            glDeleteQueries(FRAME_LATENCY * MAX_SCOPES * 2, queries);
+        created = false;
+        enabled = false;
+    }
+
+    // turns profiling on or off, recording a Chrome trace of every scope if trace is true
+    void SetEnabled(bool enable, bool trace = false)
+    {
+        enabled = enable && created;
+        tracing = enabled && trace;
+        if (tracing)
+            traceEvents.reserve(MAX_TRACE_EVENTS);
+    }
+
+    bool Enabled() const
+    {
+        return enabled;
+    }
+
+    // starts a new frame, collecting the oldest frame in the ring if the GPU has finished it
+    void BeginFrame()
+    {
+        if (!enabled)
+            return;
+
+        frameSlot = (frameSlot + 1) % FRAME_LATENCY;
+        FrameRecord& record = frames[frameSlot];
+        if (record.scopeCount > 0)
+            Collect(record);
+        record.scopeCount = 0;
+        record.openScopes = 0;
+    }
+
+    // starts timing a stage, returns the scope index to pass to EndScope (-1 if nothing is recorded)
+    int BeginScope(const char* name)
+    {
+        FrameRecord& record = frames[frameSlot];
+        if (!enabled || record.scopeCount == MAX_SCOPES)
+            return -1;
+
+        int scope = record.scopeCount++;
+        ScopeRecord& scopeRecord = record.scopes[scope];
+        scopeRecord.stage = FindStage(name, record.openScopes);
+        scopeRecord.cpuStart = Now();
+        glQueryCounter(QueryAt(frameSlot, scope, 0), GL_TIMESTAMP);
+        record.openScopes++;
+        return scope;
+    }
+
+    // stops timing a stage
+    void EndScope(int scope)
+    {
+        if (!enabled || scope < 0)
+            return;
+
+        FrameRecord& record = frames[frameSlot];
+        record.lastQuery = QueryAt(frameSlot, scope, 1);
+        glQueryCounter(record.lastQuery, GL_TIMESTAMP);
+        record.scopes[scope].cpuEnd = Now();
+        record.openScopes--;
+    }
+
+    // prints the average CPU and GPU milliseconds of every stage over the last HISTORY collected frames
+    void PrintTable(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(3);
+        out << std::left << std::setw(24) << "Stage" << std::right << std::setw(10) << "CPU ms" << std::setw(10) << "GPU ms" << "\n";
+        for (int i = 0; i < stageCount; i++)
+        {
+            const StageStats& stage = stages[i];
+            int samples = stage.samples < HISTORY ? stage.samples : HISTORY;
+            double cpuTotal = 0.0, gpuTotal = 0.0;
+            for (int sample = 0; sample < samples; sample++)
+            {
+                cpuTotal += stage.cpuHistory[sample];
+                gpuTotal += stage.gpuHistory[sample];
+            }
+            samples = samples > 0 ? samples : 1;
+            out << std::left << std::setw(24) << (std::string(stage.depth * 2, ' ') + stage.name) << std::right
+                << std::setw(10) << cpuTotal / samples << std::setw(10) << gpuTotal / samples << "\n";
+        }
+        out << "(" << droppedFrames << " frames dropped waiting for GPU results)" << std::endl;
+    }
+
+    // writes the recorded trace in the Chrome trace event format (open with chrome://tracing or Perfetto)
+    bool WriteChromeTrace(const char* filename) const
+    {
+        std::ofstream file(filename);
+        if (!file)
+            return false;
+
+        file << std::fixed << std::setprecision(3);
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (const TraceEvent& event : traceEvents)
+        {
+            file << ",\n{\"name\":\"" << stages[event.stage].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+                 << ",\"ts\":" << event.startMicroseconds << ",\"dur\":" << event.durationMicroseconds << "}";
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+
+private:
+    struct ScopeRecord
+    {
+        int stage;
+        double cpuStart;    // Milliseconds since Create
+        double cpuEnd;
+    };
+
+    struct FrameRecord
+    {
+        ScopeRecord scopes[MAX_SCOPES];
+        int scopeCount = 0;
+        int openScopes = 0;
+        GLuint lastQuery = 0;   // Queries finish in order, once this one is available the frame is complete
+    };
+
+    struct StageStats
+    {
+        const char* name;
+        int depth;
+        double cpuHistory[HISTORY];
+        double gpuHistory[HISTORY];
+        int samples;
+    };
+
+    struct TraceEvent
+    {
+        int stage;
+        bool gpu;
+        double startMicroseconds;
+        double durationMicroseconds;
+    };
+
+    // reads back a finished frame, or drops it if the GPU is still working on it
+    void Collect(const FrameRecord& record)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(record.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            droppedFrames++;
+            return;
+        }
+
+        for (int scope = 0; scope < record.scopeCount; scope++)
+        {
+            GLuint64 gpuStart = 0, gpuEnd = 0;
+            glGetQueryObjectui64v(QueryAt(frameSlot, scope, 0), GL_QUERY_RESULT, &gpuStart);
+            glGetQueryObjectui64v(QueryAt(frameSlot, scope, 1), GL_QUERY_RESULT, &gpuEnd);
+
+            const ScopeRecord& scopeRecord = record.scopes[scope];
+            StageStats& stage = stages[scopeRecord.stage];
+            double cpuMilliseconds = scopeRecord.cpuEnd - scopeRecord.cpuStart;
+            double gpuMilliseconds = (gpuEnd - gpuStart) / 1.0e6;
+            stage.cpuHistory[stage.samples % HISTORY] = cpuMilliseconds;
+            stage.gpuHistory[stage.samples % HISTORY] = gpuMilliseconds;
+            stage.samples++;
+
+            if (tracing && traceEvents.size() + 2 <= MAX_TRACE_EVENTS)
+            {
+                double gpuStartMicroseconds = (static_cast<double>(gpuStart) - static_cast<double>(gpuStartNanoseconds)) / 1.0e3;
+                traceEvents.push_back({ scopeRecord.stage, false, scopeRecord.cpuStart * 1.0e3, cpuMilliseconds * 1.0e3 });
+                traceEvents.push_back({ scopeRecord.stage, true, gpuStartMicroseconds, gpuMilliseconds * 1.0e3 });
+            }
+        }
+    }
+
+    // returns the stage for a name, adding it the first time it is seen
+    int FindStage(const char* name, int depth)
+    {
+        for (int i = 0; i < stageCount; i++)
+        {
+            if (stages[i].name == name || strcmp(stages[i].name, name) == 0)
+                return i;
+        }
+        if (stageCount == MAX_STAGES)
+            return MAX_STAGES - 1;
+
+        StageStats& stage = stages[stageCount];
+        stage.name = name;
+        stage.depth = depth;
+        stage.samples = 0;
+        return stageCount++;
+    }
+
+    GLuint QueryAt(int slot, int scope, int end) const
+    {
+        return queries[(slot * MAX_SCOPES + scope) * 2 + end];
+    }
+
+    double Now() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    GLuint queries[FRAME_LATENCY * MAX_SCOPES * 2];
+    FrameRecord frames[FRAME_LATENCY];
+    int frameSlot = 0;
+    StageStats stages[MAX_STAGES];
+    int stageCount = 0;
+    size_t droppedFrames = 0;
+    std::vector<TraceEvent> traceEvents;
+    std::chrono::steady_clock::time_point start;
+    GLint64 gpuStartNanoseconds = 0;
+    bool created = false;
+    bool enabled = false;
+    bool tracing = false;
+};
+
+// Times the enclosing block as a named stage of the profiler
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler& stageProfiler, const char* name) : profiler(stageProfiler), scope(stageProfiler.BeginScope(name))
+    {
+    }
+    ~ProfileScope()
+    {
+        profiler.EndScope(scope);
+    }
+
+    // hands the scope over to the caller so it can be ended before the block does (pass the result to EndScope)
+    int Release()
+    {
+        int released = scope;
+        scope = -1;
+        return released;
+    }
+
+private:
+    Profiler& profiler;
+    int scope;
+};
+#endif
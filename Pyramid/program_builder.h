@@ -0,0 +1,138 @@
+#ifndef PROGRAM_BUILDER_H
+#define PROGRAM_BUILDER_H
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <unordered_map>
+
+// Compiles and links shader programs without waiting on each step. Submit queues the compiles and the link and returns
+// the program straight away; the driver works on them in the background (on its own threads when
+// GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile is available), Ready polls GL_COMPLETION_STATUS_KHR,
+// and the status is only queried in Finish. Submitting every program before finishing any makes startup cost roughly the
+// slowest program instead of the sum of all of them
+class ProgramBuilder
+{
+public:
+    // asks the driver for as many compiler threads as it wants, returns true if compiles run in parallel
+    bool Create()
+    {
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else if (GLEW_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+        return parallel;
+    }
+
+    // starts compiling and linking a vertex and fragment shader program
+    GLuint Submit(const char* vtxShaderSource, const char* fragShaderSource)
+    {
+        Job job = {};
+        job.shaders[job.shaderCount++] = CompileShader(GL_VERTEX_SHADER, vtxShaderSource);
+        job.shaders[job.shaderCount++] = CompileShader(GL_FRAGMENT_SHADER, fragShaderSource);
+        return Link(job);
+    }
+
+    // starts compiling and linking a compute shader program
+    GLuint SubmitCompute(const char* compShaderSource)
+    {
+        Job job = {};
+        job.shaders[job.shaderCount++] = CompileShader(GL_COMPUTE_SHADER, compShaderSource);
+        return Link(job);
+    }
+
+    // returns true once the driver has finished a submitted program, without waiting
+    bool Ready(GLuint programId) const
+    {
+        if (!parallel)
+            return true;
+        GLint completed = GL_FALSE;
+        glGetProgramiv(programId, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+
+    // waits for a submitted program, prints the compile or link errors if it failed and releases its shader objects
+    bool Finish(GLuint programId)
+    {
+        auto job = jobs.find(programId);
+        if (job == jobs.end())
+            return true;
+
+        GLint success = 0;
+        glGetProgramiv(programId, GL_LINK_STATUS, &success);
+        if (!success)
+            PrintErrors(programId, job->second);
+
+        for (int i = 0; i < job->second.shaderCount; i++)
+        {
+            glDetachShader(programId, job->second.shaders[i]);
+            glDeleteShader(job->second.shaders[i]);
+        }
+        jobs.erase(job);
+        return success != 0;
+    }
+
+    // returns the number of submitted programs that have not been finished
+    size_t Pending() const
+    {
+        return jobs.size();
+    }
+
+    bool Parallel() const
+    {
+        return parallel;
+    }
+
+private:
+    struct Job
+    {
+        GLuint shaders[2];
+        int shaderCount;
+    };
+
+    static GLuint CompileShader(GLenum type, const char* source)
+    {
+        GLuint shaderId = glCreateShader(type);
+        glShaderSource(shaderId, 1, &source, NULL);
+        glCompileShader(shaderId);
+        return shaderId;
+    }
+
+    GLuint Link(const Job& job)
+    {
+        GLuint programId = glCreateProgram();
+        for (int i = 0; i < job.shaderCount; i++)
+            glAttachShader(programId, job.shaders[i]);
+        glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);    // Allow the binary cache to store it
+        glLinkProgram(programId);
+        jobs[programId] = job;
+        return programId;
+    }
+
+    // prints the errors of the first shader that failed to compile, or the link errors if every shader compiled
+    static void PrintErrors(GLuint programId, const Job& job)
+    {
+        char infoLog[512];
+        for (int i = 0; i < job.shaderCount; i++)
+        {
+            GLint compiled = 0;
+            glGetShaderiv(job.shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (!compiled)
+            {
+                GLint type = 0;
+                glGetShaderiv(job.shaders[i], GL_SHADER_TYPE, &type);
+                const char* stage = type == GL_VERTEX_SHADER ? "VERTEX" : type == GL_FRAGMENT_SHADER ? "FRAGMENT" : "COMPUTE";
+                glGetShaderInfoLog(job.shaders[i], sizeof(infoLog), NULL, infoLog);
+                std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+                return;
+            }
+        }
+        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    std::unordered_map<GLuint, Job> jobs;   // Submitted programs by handle
+    bool parallel = false;
+};
+#endif
@@ -0,0 +1,176 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Stores linked shader programs on disk with glGetProgramBinary and restores them with glProgramBinary, skipping the
+// compile and link on later launches. Entries are keyed by the program's source hash and by the driver's vendor,
+// renderer and version strings, so a driver update or a different GPU never loads a stale binary; a binary the driver
+// rejects anyway is deleted and the caller compiles from source. Programs must be linked with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set to be stored
+class ProgramBinaryCache
+{
+public:
+    // enables the cache in a directory (created if needed), returns false if the driver cannot save program binaries
+    bool Create(const std::string& cacheDirectory)
+    {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if (formatCount == 0)
+            return false;
+
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+        if (error)
+            return false;
+
+        directory = cacheDirectory;
+        driver = std::string(GLString(GL_VENDOR)) + "|" + GLString(GL_RENDERER) + "|" + GLString(GL_VERSION);
+        driverHash = HashString(driver, 14695981039346656037ull);
+        enabled = true;
+        return true;
+    }
+
+    // creates a program from a stored binary, returns false (leaving programId 0) if there is no usable binary
+    bool Load(uint64_t sourceHash, GLuint& programId)
+    {
+        programId = 0;
+        if (!enabled)
+            return false;
+
+        std::ifstream file(EntryPath(sourceHash), std::ios::binary);
+        if (!file)
+        {
+            misses++;
+            return false;
+        }
+
+        EntryHeader header = {};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || header.magic != MAGIC || header.driverLength != driver.size() || header.binaryLength > MAX_BINARY_LENGTH)
+        {
+            Reject(sourceHash);
+            return false;
+        }
+        std::string entryDriver(header.driverLength, '\0');
+        std::vector<char> binary(header.binaryLength);
+        file.read(&entryDriver[0], entryDriver.size());
+        file.read(binary.data(), binary.size());
+        if (!file || header.sourceHash != sourceHash || entryDriver != driver)
+        {
+            Reject(sourceHash);
+            return false;
+        }
+
+        programId = glCreateProgram();
+        glProgramBinary(programId, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint success = 0;
+        glGetProgramiv(programId, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(programId);
+            programId = 0;
+            Reject(sourceHash);
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // writes the binary of a linked program, returns true if it was stored
+    bool Store(uint64_t sourceHash, GLuint programId) const
+    {
+        if (!enabled)
+            return false;
+
+        GLint length = 0;
+        glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(programId, length, &length, &format, binary.data());
+
+        EntryHeader header = { MAGIC, format, sourceHash, static_cast<uint32_t>(driver.size()), static_cast<uint32_t>(length) };
+        std::ofstream file(EntryPath(sourceHash), std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(driver.data(), driver.size());
+        file.write(binary.data(), length);
+        return static_cast<bool>(file);
+    }
+
+    bool Enabled() const
+    {
+        return enabled;
+    }
+
+    // returns the number of programs restored from the cache
+    size_t Hits() const
+    {
+        return hits;
+    }
+
+    // returns the number of programs that had to be compiled (no entry, or an entry the driver rejected)
+    size_t Misses() const
+    {
+        return misses;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x42505950;  // "PYPB"
+    static const uint32_t MAX_BINARY_LENGTH = 64 * 1024 * 1024;     // Larger entries are treated as corrupt
+
+    // Layout of the start of a cache entry, followed by the driver string and the program binary
+    struct EntryHeader
+    {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t sourceHash;
+        uint32_t driverLength;
+        uint32_t binaryLength;
+    };
+
+    std::string EntryPath(uint64_t sourceHash) const
+    {
+        char name[40];
+        snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(sourceHash ^ driverHash));
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    // deletes an entry that could not be used
+    void Reject(uint64_t sourceHash)
+    {
+        std::error_code error;
+        std::filesystem::remove(EntryPath(sourceHash), error);
+        misses++;
+    }
+
+    static const char* GLString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value != nullptr ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    static uint64_t HashString(const std::string& text, uint64_t hash)
+    {
+        for (char c : text)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        return hash;
+    }
+
+    std::string directory;
+    std::string driver;     // Vendor, renderer and version the entries were created with
+    uint64_t driverHash = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    bool enabled = false;
+};
+#endif
@@ -0,0 +1,93 @@
+#ifndef QUANTIZED_VERTEX_H
+#define QUANTIZED_VERTEX_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "indexed_mesh.h"
+
+// A 16 byte mesh vertex, half the size of the 8 float layout it is made from. Positions are snorm16 relative to the
+// centre of the mesh bounds and divided by their largest half extent, so one uniform scale and offset per mesh brings
+// them back; normals are octahedral encoded into two snorm16 components; texture coordinates are unorm16. Every
+// attribute is read with normalized glVertexAttribPointer formats, so only the normal needs decoding in the shader
+struct QuantizedVertex
+{
+    int16_t position[4];    // xyz, w unused (keeps the normal 4 byte aligned)
+    int16_t normal[2];
+    uint16_t textureCoordinate[2];
+};
+
+// returns the octahedral encoding of a unit vector, both components in [-1, 1]. A zero length (or NaN) normal is
+// encoded as (0, 0, 1)
+inline glm::vec2 OctahedralEncode(glm::vec3 normal)
+{
+    const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (!(length > 0.0f))
+        return glm::vec2(0.0f);
+    normal *= 1.0f / length;
+    glm::vec2 encoded(normal.x, normal.y);
+    if (normal.z < 0.0f)
+    {
+        // Fold the lower hemisphere over the diagonals of the square
+        encoded = glm::vec2((1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f),
+                            (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return encoded;
+}
+
+inline int16_t QuantizeSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+inline uint16_t QuantizeUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+}
+
+// packs a mesh with position (3), normal (3) and texture coordinate (2) floats per vertex. Model space positions are
+// positionOffset + stored position * positionScale. Returns false, leaving vertices empty, if the layout differs or a
+// texture coordinate is outside [0, 1] (unorm16 cannot hold it)
+inline bool QuantizeVertices(const IndexedMesh& mesh, std::vector<QuantizedVertex>& vertices, glm::vec3& positionOffset, float& positionScale)
+{
+    vertices.clear();
+    const size_t vertexCount = mesh.VertexCount();
+    if (mesh.floatsPerVertex != 8 || vertexCount == 0)
+        return false;
+
+    glm::vec3 low(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+    glm::vec3 high = low;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float* vertex = &mesh.vertices[i * 8];
+        low = glm::min(low, glm::vec3(vertex[0], vertex[1], vertex[2]));
+        high = glm::max(high, glm::vec3(vertex[0], vertex[1], vertex[2]));
+        if (vertex[6] < 0.0f || vertex[6] > 1.0f || vertex[7] < 0.0f || vertex[7] > 1.0f)
+            return false;
+    }
+    positionOffset = (low + high) * 0.5f;
+    glm::vec3 halfExtent = (high - low) * 0.5f;
+    positionScale = std::max(std::max(halfExtent.x, halfExtent.y), std::max(halfExtent.z, 1e-20f));
+
+    vertices.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float* vertex = &mesh.vertices[i * 8];
+        QuantizedVertex& packed = vertices[i];
+        for (int c = 0; c < 3; c++)
+            packed.position[c] = QuantizeSnorm16((vertex[c] - positionOffset[c]) / positionScale);
+        packed.position[3] = 0;
+
+        glm::vec2 normal = OctahedralEncode(glm::vec3(vertex[3], vertex[4], vertex[5]));
+        packed.normal[0] = QuantizeSnorm16(normal.x);
+        packed.normal[1] = QuantizeSnorm16(normal.y);
+        packed.textureCoordinate[0] = QuantizeUnorm16(vertex[6]);
+        packed.textureCoordinate[1] = QuantizeUnorm16(vertex[7]);
+    }
+    return true;
+}
+#endif
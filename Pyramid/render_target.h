@@ -0,0 +1,94 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+
+#include <cstdio>
+#include <vector>
+
+// Offscreen framebuffer with an 8 bit RGBA color buffer and a depth buffer, used to render frames that are read back
+// instead of shown in the window
+class RenderTarget
+{
+public:
+    // creates the framebuffer and its attachments
+    bool Create(int frameWidth, int frameHeight)
+    {
+        width = frameWidth;
+        height = frameHeight;
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    // releases the framebuffer and its attachments
+    void Destroy()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        framebuffer = colorBuffer = depthBuffer = 0;
+    }
+
+    // reads the color buffer into pixels as tightly packed RGBA rows, bottom row first
+    void ReadPixels(std::vector<unsigned char>& pixels) const
+    {
+        pixels.resize(static_cast<size_t>(width) * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    GLuint Framebuffer() const
+    {
+        return framebuffer;
+    }
+    int Width() const
+    {
+        return width;
+    }
+    int Height() const
+    {
+        return height;
+    }
+
+private:
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// writes pixels read with RenderTarget::ReadPixels to a binary PPM image, returns false if the file cannot be written
+inline bool WritePPM(const char* filename, const std::vector<unsigned char>& pixels, int width, int height)
+{
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--)   // PPM rows go top to bottom
+    {
+        for (int x = 0; x < width; x++)
+            fwrite(&pixels[(static_cast<size_t>(y) * width + x) * 4], 1, 3, file);
+    }
+    return fclose(file) == 0;
+}
+#endif
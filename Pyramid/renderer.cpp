@@ -0,0 +1,2049 @@
+#include <iostream>         // Allow for input/output
+#include <chrono>           // Benchmark timing
+#include <random>           // Benchmark lights
+#include <iomanip>          // Benchmark output
+#include <cmath>            // Pyramid grid
+#include <algorithm>        // Mesh benchmark shuffle
+
+// GLM Libraries
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "renderer.h" // Renderer globals and functions
+#include "uniforms.h" // Uniform location cache
+#include "gbuffer.h" // Deferred shading geometry buffer
+#include "benchmark.h" // Frame time benchmark
+#include "instance_buffer.h" // Per-instance model matrices and colors
+#include "indexed_mesh.h" // Vertex welding and index buffers
+#include "mesh_optimizer.h" // Vertex cache, overdraw and vertex fetch ordering
+#include "quantized_vertex.h" // Packed 16 byte vertex format
+#include "shader_registry.h" // Shader programs shared by source
+#include "program_cache.h" // On-disk shader program binaries
+#include "program_builder.h" // Background shader compilation
+#include "texture_loader.h" // Background texture loading
+#include "software_rasterizer.h" // CPU rendering backend
+#include "gpu_culling.h" // Compute shader object culling and indirect draws
+
+// STB Library to load an image (decoded on the texture loader threads)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+using namespace std; 
+
+// Shader program Macro
+#ifndef GLSL
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+#endif
+
+// Shader library Macro (no #version line, inserted into a shader with UInsertShaderLibrary)
+#ifndef GLSL_LIBRARY
+#define GLSL_LIBRARY(Source) #Source
+#endif
+
+GLFWwindow* gWindow = nullptr;
+GLMesh gMesh;
+GLuint gTextureId;
+glm::vec2 gUVScale(1.0f, 1.0f);
+
+SceneLights gSceneLights{
+    { glm::vec3(2.0f, 0.5f, 1.0f), glm::vec3(0.3f), glm::vec3(0.1f, 0.8f, 0.1f), 1.0f, 0.0f}, // Greenish Key light 100% intensity
+    { glm::vec3(-3.0f, 2.0f, 1.0f), glm::vec3(0.3f), glm::vec3(0.1f, 0.1f, 0.8f), 0.1f, 0.0f},  //Fill light 10% intensity 
+}; 
+
+LightBuffer gLightBuffer;
+ClusterGrid gClusterGrid;
+bool gUseClusteredShading = true;
+bool gUseDeferredShading = false;
+
+GLuint gTargetFramebuffer = 0;
+int gFramebufferWidth = WINDOW_WIDTH;
+int gFramebufferHeight = WINDOW_HEIGHT;
+
+Profiler gProfiler;
+
+Camera gCamera(glm::vec3(0.0f, 0.5f, 7.0f));
+float gDeltaTime = 0.0f;
+
+SceneRegistry gScene;
+
+bool gIsLampOrbiting = true;
+
+const char* gShaderCacheDirectory = "shader_cache";
+
+bool gMapTextureFiles = true;
+
+bool gUseQuantizedVertices = true;
+
+int gPyramidCount = 1;
+bool gUseInstancing = true;
+
+bool gUseFrustumCulling = true;
+bool gUseGpuCulling = false;
+CullingStats gCullingStats;
+
+namespace
+{
+    // Shader programs shared by source, owns every program below
+    ShaderRegistry gShaderRegistry;
+    // Linked programs saved to disk between runs
+    ProgramBinaryCache gProgramCache;
+
+    // Programs compiled and linked in the background, and the ones not yet checked
+    struct PendingProgram
+    {
+        uint64_t hash;
+        GLuint programId;
+    };
+    ProgramBuilder gProgramBuilder;
+    vector<PendingProgram> gPendingPrograms;
+
+    // Textures decoded on worker threads
+    TextureLoader gTextureLoader;
+    const char* gTextureFilename = "brick.jpg";     // Scene texture, reloaded by UTextureLoadBenchmark
+
+    // Decalre Shader program object
+    GLuint shaderProgramId;
+    GLuint lampProgramId;   // Every lamp is drawn with the same program
+
+    // Shader storage binding points (must match the shaders)
+    const GLuint LIGHT_BUFFER_BINDING = 0;
+    const GLuint CLUSTER_BOUNDS_BINDING = 1;
+    const GLuint CLUSTER_COUNT_BINDING = 2;
+    const GLuint CLUSTER_INDEX_BINDING = 3;
+
+    // Cluster culling program
+    GLuint clusterCullProgramId;
+    GLint gClusterViewLoc;
+    GLint gClusterLimitsLoc;
+
+    // GPU-driven object culling and drawing
+    const GLuint OBJECT_BOUNDS_BINDING = 4;
+    const GLuint DRAW_COMMAND_BINDING = 5;
+    const GLuint DRAW_COUNT_BINDING = 6;
+    GpuCulling gGpuCulling;
+    GLuint objectCullProgramId;
+    GLint gObjectCullPlanesLoc;
+    GLint gObjectCullCountLoc;
+    GLint gObjectCullIndexCountLoc;
+    GLint gObjectCullCompactLoc;
+    uint64_t gGpuSceneVersion = UINT64_MAX;     // gScene.Version() when every object's bounds and instance were written
+    vector<GPUObjectBounds> gObjectBounds;
+
+    // Deferred shading resources
+    GBuffer gGBuffer;
+    GLuint gBufferProgramId;
+    GLuint deferredLightingProgramId;
+    GLuint gEmptyVao;       // Full-screen triangle vertices are generated in the vertex shader
+    const GLuint GBUFFER_TEXTURE_UNIT = 1;  // G-buffer textures use units 1 to 3, the pyramid texture uses unit 0
+
+    // Model matrices and colors of every scene object followed by every lamp
+    InstanceBuffer gInstances;
+    const GLuint INSTANCE_ATTRIBUTE_LOCATION = 3;   // Locations 3 to 7 (must match the shaders)
+
+    // Ranges of the instance buffer holding the scene objects of one mesh and material
+    struct SceneBatch
+    {
+        uint32_t mesh;
+        uint32_t material;
+        GLuint firstInstance;
+        GLuint count;
+    };
+    vector<SceneBatch> gSceneBatches;
+    GLuint gFirstLampInstance;  // Visible lamps follow the visible objects
+
+    // Bounding volume hierarchies of the scene objects and lamps for frustum culling, leaf ids are indices into gScene
+    // and gSceneLights
+    AABBTree gObjectTree;
+    AABBTree gLampTree;
+    vector<int32_t> gObjectLeaves;
+    vector<int32_t> gLampLeaves;
+    uint64_t gSyncedSceneVersion = UINT64_MAX;     // gScene.Version() when the object boxes were last updated
+    vector<glm::mat4> gLampModels;      // Set by UUpdateLightBuffer
+    vector<uint32_t> gVisibleObjects;   // Found by each frame's culling pass
+    vector<uint32_t> gVisibleLamps;
+
+    // Uniform locations resolved once after the shader programs are linked
+    ShaderUniforms gPyramidUniforms;
+    TransformUniforms gPyramidTransform;
+    LightingUniforms gForwardLighting;
+    GLint gUVScaleLoc;
+    TransformUniforms gGBufferTransform;
+    GLint gGBufferUVScaleLoc;
+    LightingUniforms gDeferredLighting;
+    TransformUniforms gLampTransform;
+}
+
+// Vertex Shader Source Code
+const GLchar* vertexShaderSource = GLSL(440,
+    // Declare attribute locations
+    layout(location = 0) in vec3 position;          // Vertex position 
+    layout(location = 1) in vec3 normal;            // Normals (decoded by DecodeNormal)
+    layout(location = 2) in vec2 textureCoordinate; // Textures
+    layout(location = 3) in mat4 model;             // Per-instance model matrix (locations 3 to 6)
+
+    // The forward and G-buffer programs share this shader; invariant and precise make both compute the same coverage
+    // and the same inputs to the lighting library, whatever else the compiler does with each program
+    invariant gl_Position;
+    precise out vec3 vertexNormal;              // Outgoing normals to fragment shader
+    precise out vec3 vertexFragmentPos;         // Outgoing color / pixels to fragment shader
+    out vec2 vertexTextureCoordinate;           // Outgoing texture to fragment shader
+
+    // Uniform/Global variables for transform matrices
+    uniform mat4 view;
+    uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transform vertices to clip coordinates
+
+    vertexFragmentPos = vec3(model * vec4(position, 1.0f));         // Get fragment / pixel position into world space only
+
+    // Get normals in world space only (exclude normal translation properties)
+    vertexNormal = mat3(transpose(inverse(model))) * DecodeNormal(normal);
+    vertexTextureCoordinate = textureCoordinate;
+}
+);
+
+// Normal Decoding Shader Libraries (one is inserted after the #version line of the pyramid vertex shader to match the
+// vertex format of the mesh)
+const GLchar* octahedralNormalLibrary = GLSL_LIBRARY(
+    // Quantized meshes store normals octahedral encoded in x and y
+    vec3 DecodeNormal(vec3 encoded)
+    {
+        vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+        if (n.z < 0.0)
+            n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        return normalize(n);
+    }
+);
+
+const GLchar* floatNormalLibrary = GLSL_LIBRARY(
+    vec3 DecodeNormal(vec3 encoded)
+    {
+        return encoded;
+    }
+);
+
+// Lighting Shader Library Source Code (inserted after the #version line of the pyramid lighting shaders)
+const GLchar* lightingShaderLibrary = GLSL_LIBRARY(
+    // Scene lights (layout must match GPULight and GPULightHeader in light_buffer.h)
+    struct Light
+    {
+        vec4 positionIntensity;         // xyz : position, w : intensity
+        vec4 color;                     // a : range
+    };
+    layout(std430, binding = 0) readonly buffer LightBlock
+    {
+        uint lightCount;
+        Light lights[];
+    };
+
+    // Per cluster light lists written by the cluster culling shader
+    layout(std430, binding = 2) readonly buffer ClusterCountBlock
+    {
+        uint clusterLightCount[];
+    };
+    layout(std430, binding = 3) readonly buffer ClusterIndexBlock
+    {
+        uint clusterLightIndex[];
+    };
+
+    // Uniform/Global variables for view (camera) position and matrix
+    uniform vec3 viewPosition;
+    uniform mat4 view;
+
+    // Uniform/Global variables for clustered lighting
+    uniform bool useClusters;
+    uniform uvec4 clusterDims;          // x, y : screen tiles, z : depth slices, w : max lights per cluster
+    uniform vec2 depthRange;            // Projection near and far plane
+    uniform vec2 screenSize;
+
+    /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+    // (precise keeps the compiler from contracting the arithmetic differently in the forward and deferred programs, so
+    // both shade a pixel to the same bits)
+    vec3 CalcPointLight(vec3 lightPos, vec3 lightColor, float lightIntensity, float lightRange, vec3 vertexFragmentPos, vec3 vertexNormal, vec3 viewPosition)
+    {
+        // Calculate Ambient lighting
+        vec3 ambient = lightIntensity * lightColor; 
+
+        // Calculate Diffuse lighting
+        vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+        vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance between light source and fragments/pixels
+        float impact = max(dot(norm, lightDirection), 0.2);// Calculate diffuse impact
+        vec3 diffuse = impact * lightColor;
+
+        // Calculate Specular lighting
+        float specularIntensity = 0.0f; // Set specular light strength
+        float highlightSize = 0.0f; // Set specular highlight size
+        vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+        vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
+        float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+        vec3 specular = specularIntensity * specularComponent * lightColor;
+
+        // Fade lights with a range out to zero at the edge of their range
+        float attenuation = 1.0f;
+        if (lightRange > 0.0f)
+        {
+            float ratio = distance(lightPos, vertexFragmentPos) / lightRange;
+            attenuation = pow(clamp(1.0f - pow(ratio, 4.0f), 0.0f, 1.0f), 2.0f);
+        }
+
+        // Calculate phong result
+         precise vec3 phong = (ambient + diffuse + specular) * attenuation;
+        // vec3 phong = (ambient + diffuse);
+        // vec3 phong = (ambient);
+
+        return phong;
+    }
+
+    // Calculate the contribution of one scene light
+    vec3 CalcSceneLight(uint i, vec3 fragmentPos, vec3 fragmentNormal)
+    {
+        return CalcPointLight(lights[i].positionIntensity.xyz, lights[i].color.rgb, lights[i].positionIntensity.w, lights[i].color.a, fragmentPos, fragmentNormal, viewPosition);
+    }
+
+    // Find the cluster containing a fragment (must match ClusterGrid in clusters.h)
+    uint FindCluster(vec3 fragmentPos)
+    {
+        float viewDepth = -(view * vec4(fragmentPos, 1.0f)).z;
+        uint slice = uint(max(log(viewDepth / depthRange.x) / log(depthRange.y / depthRange.x) * float(clusterDims.z), 0.0f));
+        uvec2 tile = uvec2(gl_FragCoord.xy / screenSize * vec2(clusterDims.xy));
+
+        tile = min(tile, clusterDims.xy - uvec2(1u));
+        slice = min(slice, clusterDims.z - 1u);
+        return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+    }
+
+    // Calculate all scene lights reaching a fragment, modulated by the fragment's texture color
+    vec3 CalcSceneLights(vec3 fragmentPos, vec3 fragmentNormal, vec3 textureColor)
+    {
+        precise vec3 result = vec3(0.0);
+        if (useClusters)
+        {
+            // Calculate only the lights that reach this fragment's cluster
+            uint cluster = FindCluster(fragmentPos);
+            uint count = min(clusterLightCount[cluster], clusterDims.w);
+            uint base = cluster * clusterDims.w;
+            for (uint j = 0u; j < count; j++)
+                result += CalcSceneLight(clusterLightIndex[base + j], fragmentPos, fragmentNormal) * textureColor;
+        }
+        else
+        {
+            // Calculate every scene light
+            for (uint i = 0u; i < lightCount; i++)
+                result += CalcSceneLight(i, fragmentPos, fragmentNormal) * textureColor;
+        }
+        return result;
+    }
+);
+
+// Fragment Shader Source Code (forward rendering, includes the lighting library)
+const GLchar* fragmentShaderSource = GLSL(440,
+
+    in vec3 vertexNormal;              // Incoming normals
+    in vec3 vertexFragmentPos;         // Incoming fragment position
+    in vec2 vertexTextureCoordinate;   // Incoming texture coordinates
+
+    out vec4 fragmentColor;             // Outgoing pyramid  color to GPU
+
+    // Uniform/Global variables for texture and scale 
+    uniform sampler2D uTexture; 
+    uniform vec2 uvScale;
+
+void main()
+{
+    vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);   // Pyramid texture / texture coordinates / scale
+
+    vec3 result = CalcSceneLights(vertexFragmentPos, vertexNormal, textureColor.xyz);
+
+    fragmentColor = vec4(result, 1.0); // Send results to GPU
+}
+);
+
+// G-buffer Fragment Shader Source Code (deferred rendering geometry pass)
+const GLchar* gBufferFragmentShaderSource = GLSL(440,
+
+    in vec3 vertexNormal;              // Incoming normals
+    in vec3 vertexFragmentPos;         // Incoming fragment position
+    in vec2 vertexTextureCoordinate;   // Incoming texture coordinates
+
+    // G-buffer attachments (must match GBuffer in gbuffer.h)
+    layout(location = 0) out vec4 gPosition;   // xyz : world position, w : 1 where geometry was drawn
+    layout(location = 1) out vec4 gNormal;
+    layout(location = 2) out vec4 gAlbedo;
+
+    uniform sampler2D uTexture; 
+    uniform vec2 uvScale;
+
+void main()
+{
+    gPosition = vec4(vertexFragmentPos, 1.0f);
+    gNormal = vec4(vertexNormal, 0.0f);        // Normalized by the lighting pass, as in the forward shader
+    gAlbedo = texture(uTexture, vertexTextureCoordinate * uvScale);
+}
+);
+
+// Full-screen triangle Vertex Shader Source Code (deferred rendering lighting pass)
+const GLchar* fullScreenVertexShaderSource = GLSL(440,
+void main()
+{
+    // Vertices 0, 1, 2 cover the screen with one oversized triangle
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
+);
+
+// Deferred lighting Fragment Shader Source Code (includes the lighting library)
+const GLchar* deferredLightingFragmentShaderSource = GLSL(440,
+
+    out vec4 fragmentColor;
+
+    // G-buffer textures
+    uniform sampler2D gPositionTexture;
+    uniform sampler2D gNormalTexture;
+    uniform sampler2D gAlbedoTexture;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gPositionTexture, pixel, 0);
+    if (position.w == 0.0f)
+    {
+        fragmentColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);  // Background
+        return;
+    }
+    vec3 normal = texelFetch(gNormalTexture, pixel, 0).xyz;
+    vec3 albedo = texelFetch(gAlbedoTexture, pixel, 0).xyz;
+
+    fragmentColor = vec4(CalcSceneLights(position.xyz, normal, albedo), 1.0);
+}
+);
+
+// Lamp vertex Shader Source Code
+const GLchar* lampVertexShaderSource = GLSL(440,
+    layout(location = 0) in vec3 position;  // Declare attribute locations
+    layout(location = 3) in mat4 model;     // Per-instance model matrix (locations 3 to 6)
+    layout(location = 7) in vec4 color;     // Per-instance lamp color
+
+    out vec4 lampColor;
+    
+    // Uniform/Global variables for transform matrices
+    uniform mat4 view;
+    uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices to clip coordinates
+    lampColor = color;
+}
+);
+
+// Lamp fragment Shader Source Code
+const GLchar* lampFragmentShaderSource = GLSL(440,
+
+    in vec4 lampColor;
+
+    out vec4 fragmentColor; 
+
+void main()
+{
+    fragmentColor = lampColor; // Set color to the lamp's instance color
+}
+);
+
+// Cluster light culling Compute Shader Source Code
+const GLchar* clusterCullShaderSource = GLSL(440,
+    layout(local_size_x = 64) in;       // Must match ClusterGrid::WORKGROUP_SIZE
+
+    // Scene lights (layout must match GPULight and GPULightHeader in light_buffer.h)
+    struct Light
+    {
+        vec4 positionIntensity;
+        vec4 color;                     // a : range
+    };
+    layout(std430, binding = 0) readonly buffer LightBlock
+    {
+        uint lightCount;
+        Light lights[];
+    };
+
+    // View space cluster bounds (layout must match ClusterAABB in clusters.h)
+    struct ClusterBounds
+    {
+        vec4 minPoint;
+        vec4 maxPoint;
+    };
+    layout(std430, binding = 1) readonly buffer ClusterBoundsBlock
+    {
+        ClusterBounds clusters[];
+    };
+
+    // Per cluster light lists
+    layout(std430, binding = 2) writeonly buffer ClusterCountBlock
+    {
+        uint clusterLightCount[];
+    };
+    layout(std430, binding = 3) writeonly buffer ClusterIndexBlock
+    {
+        uint clusterLightIndex[];
+    };
+
+    uniform mat4 view;
+    uniform uvec2 clusterLimits;        // x : cluster count, y : max lights per cluster
+
+    bool SphereIntersectsAABB(vec3 center, float radius, vec3 minPoint, vec3 maxPoint)
+    {
+        vec3 offset = clamp(center, minPoint, maxPoint) - center;
+        return dot(offset, offset) <= radius * radius;
+    }
+
+void main()
+{
+    uint cluster = gl_GlobalInvocationID.x;
+    if (cluster >= clusterLimits.x)
+        return;
+
+    // Append every light whose range overlaps the cluster (unbounded lights reach every cluster). Lights that do not
+    // fit are still counted so overflowing clusters can be reported
+    uint count = 0u;
+    uint base = cluster * clusterLimits.y;
+    for (uint i = 0u; i < lightCount; i++)
+    {
+        float range = lights[i].color.a;
+        vec3 center = vec3(view * vec4(lights[i].positionIntensity.xyz, 1.0f));
+        if (range <= 0.0f || SphereIntersectsAABB(center, range, clusters[cluster].minPoint.xyz, clusters[cluster].maxPoint.xyz))
+        {
+            if (count < clusterLimits.y)
+                clusterLightIndex[base + count] = i;
+            count++;
+        }
+    }
+    clusterLightCount[cluster] = count;
+}
+);
+
+// Object Culling Compute Shader Source Code
+const GLchar* objectCullShaderSource = GLSL(440,
+    layout(local_size_x = 64) in;       // Must match GpuCulling::WORKGROUP_SIZE
+
+    // World space object bounds (layout must match GPUObjectBounds in gpu_culling.h)
+    struct ObjectBounds
+    {
+        vec4 low;
+        vec4 high;
+    };
+    layout(std430, binding = 4) readonly buffer ObjectBoundsBlock
+    {
+        ObjectBounds objects[];
+    };
+
+    // Indirect draws (layout must match DrawElementsIndirectCommand in gpu_culling.h)
+    struct DrawCommand
+    {
+        uint count;
+        uint instanceCount;
+        uint firstIndex;
+        int baseVertex;
+        uint baseInstance;
+    };
+    layout(std430, binding = 5) writeonly buffer DrawCommandBlock
+    {
+        DrawCommand commands[];
+    };
+    layout(std430, binding = 6) buffer DrawCountBlock
+    {
+        uint drawCount;
+    };
+
+    uniform vec4 frustumPlanes[6];      // Normals point into the frustum
+    uniform uint objectCount;
+    uniform uint indexCount;
+    uniform bool compact;               // Append visible objects for a draw count read from drawCount
+
+    // Same test as Frustum::Test: outside if the corner furthest along a plane's normal is behind it
+    bool Visible(vec3 low, vec3 high)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            vec3 positive = mix(low, high, greaterThanEqual(frustumPlanes[i].xyz, vec3(0.0f)));
+            if (dot(frustumPlanes[i].xyz, positive) + frustumPlanes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+void main()
+{
+    uint object = gl_GlobalInvocationID.x;
+    if (object >= objectCount)
+        return;
+
+    // Object i is instance i, its model matrix is read from the instance buffer through baseInstance
+    bool visible = Visible(objects[object].low.xyz, objects[object].high.xyz);
+    if (visible)
+    {
+        uint slot = atomicAdd(drawCount, 1u);
+        if (compact)
+            commands[slot] = DrawCommand(indexCount, 1u, 0u, 0, object);
+    }
+    if (!compact)
+        commands[object] = DrawCommand(indexCount, visible ? 1u : 0u, 0u, 0, object);
+}
+);
+
+
+// Function to create the mesh, shader programs, texture and lighting buffers used to render a frame
+bool UCreateRenderer()
+{
+    UCreateMesh(gMesh); // Call function to create pyramid VBO/VAO
+    gInstances.Create(gMesh.vao, INSTANCE_ATTRIBUTE_LOCATION);   // Per-instance attributes of the pyramid VAO
+
+    // Restore programs linked by earlier runs from the binary cache when the driver supports it, and submit the rest
+    // to the driver's compiler threads
+    auto programStart = chrono::steady_clock::now();
+    if (gShaderCacheDirectory != nullptr && !gProgramCache.Create(gShaderCacheDirectory))
+        cout << "Shader binary cache unavailable, compiling from source" << endl;
+    gProgramBuilder.Create();
+
+    // Create fucntion to create shader programs - pyramid (forward and deferred) and lamp
+    const string forwardFragmentSource = UInsertShaderLibrary(fragmentShaderSource, lightingShaderLibrary);
+    const string deferredLightingSource = UInsertShaderLibrary(deferredLightingFragmentShaderSource, lightingShaderLibrary);
+    const string meshVertexSource = UInsertShaderLibrary(vertexShaderSource, gMesh.quantized ? octahedralNormalLibrary : floatNormalLibrary);
+    if (!UAcquireShaderProgram(meshVertexSource.c_str(), forwardFragmentSource.c_str(), shaderProgramId))
+        return false;
+    if (!UAcquireShaderProgram(meshVertexSource.c_str(), gBufferFragmentShaderSource, gBufferProgramId))
+        return false;
+    if (!UAcquireShaderProgram(fullScreenVertexShaderSource, deferredLightingSource.c_str(), deferredLightingProgramId))
+        return false;
+    if (!UAcquireShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, lampProgramId))
+        return false;
+    if (!UAcquireComputeProgram(clusterCullShaderSource, clusterCullProgramId))
+        return false;
+    if (!UAcquireComputeProgram(objectCullShaderSource, objectCullProgramId))
+        return false;
+    double programMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - programStart).count();
+        
+    // Decode the texture on the loader threads while the programs compile, it is uploaded by URender once ready
+    gTextureLoader.Create(0, gMapTextureFiles);
+    // Prefer the copy texture_cooker compressed to BC1 with its mips, when the driver can sample it
+    bool useCooked = filesystem::exists("brick.ktx2") && TextureLoader::CompressedFormat(VK_FORMAT_BC1_RGB_UNORM_BLOCK) != 0;
+    const char* texFilename = useCooked ? "brick.ktx2" : "brick.jpg";
+    gTextureFilename = texFilename;
+    if (!UCreateTexture(texFilename, gTextureId))       // Call function to generate texture passing texture image file
+    {
+        cout << "Failed to load texture " << texFilename << endl;
+        return false;
+    }
+
+    // The programs are first needed to resolve their uniforms, wait for them here
+    auto finishStart = chrono::steady_clock::now();
+    if (!UFinishShaderPrograms())
+        return false;
+    programMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - finishStart).count();
+
+    cout << "Shader programs: " << gShaderRegistry.Count() << " linked, " << gShaderRegistry.Reuses() << " shared"
+         << (gProgramBuilder.Parallel() ? ", compiled in parallel" : "") << endl;
+    if (gProgramCache.Enabled())
+    {
+        bool warm = gProgramCache.Misses() == 0;
+        cout << "Shader startup: " << programMilliseconds << " ms (" << (warm ? "warm" : "cold") << ", " << gProgramCache.Hits()
+             << " loaded from cache, " << gProgramCache.Misses() << " compiled)" << endl;
+    }
+    else
+        cout << "Shader startup: " << programMilliseconds << " ms (no cache)" << endl;
+   
+    UResolveUniforms();     // Cache uniform locations so the render loop does no lookups
+
+    gLightBuffer.Create(LIGHT_BUFFER_BINDING);  // Create storage buffer for the scene lights
+    UCreatePyramidInstances(gPyramidCount);     // Place the pyramids and lamps
+    gClusterGrid.Create(CLUSTER_BOUNDS_BINDING, CLUSTER_COUNT_BINDING, CLUSTER_INDEX_BINDING);
+    gGpuCulling.Create(OBJECT_BOUNDS_BINDING, DRAW_COMMAND_BINDING, DRAW_COUNT_BINDING);
+    if (gUseGpuCulling && !GpuCulling::DrawCountSupported())
+        cout << "ARB_indirect_parameters is not supported, culled objects are drawn as empty indirect commands" << endl;
+
+    if (!gGBuffer.Create(gFramebufferWidth, gFramebufferHeight))  // Create G-buffer for deferred shading
+    {
+        cout << "Failed to create G-buffer" << endl;
+        return false;
+    }
+    glGenVertexArrays(1, &gEmptyVao);
+    
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // Set background color to black
+
+    gProfiler.Create();     // Create timer queries for the profiler
+    return true;
+}
+
+// Function to release everything created by UCreateRenderer
+void UDestroyRenderer()
+{
+    gProfiler.Destroy();                    // Release profiler queries
+
+    UDestroyMesh(gMesh);                    // Release mesh data
+    gInstances.Destroy();                   // Release instance buffer
+    gLightBuffer.Destroy();                 // Release light buffer
+    gClusterGrid.Destroy();                 // Release cluster buffers
+    gGpuCulling.Destroy();                  // Release object culling buffers
+    gGBuffer.Destroy();                     // Release G-buffer
+    glDeleteVertexArrays(1, &gEmptyVao);
+    gTextureLoader.Destroy();               // Stop the texture loader threads
+    UDestroyTexture(gTextureId);            // Release texture data
+    gShaderRegistry.Destroy();              // Release every shader program
+}
+
+// Functioned called to render a frame
+void URender()
+{
+    gProfiler.BeginFrame();
+    ProfileScope frameScope(gProfiler, "Frame");
+
+    // Allow lights to orbit scene
+    if (gIsLampOrbiting)
+    {
+        ProfileScope scope(gProfiler, "Light orbit");
+        UOrbitLights(gDeltaTime);
+        UUpdateLightBuffer();   // Light positions changed, upload them with the next draw
+    }
+
+    // Create view matrix that transforms all world coordinates to view space
+    glm::mat4 view = gCamera.GetViewMatrix();
+
+    // Create perspective projection
+    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
+
+    // Find the objects and lamps inside the view frustum and write their instances
+    {
+        ProfileScope scope(gProfiler, "Culling");
+        UCullScene(projection * view);
+    }
+
+    // Upload light color, position, and intensity data and the changed instances in one call each, and any texture
+    // that finished loading
+    {
+        ProfileScope scope(gProfiler, "Uploads");
+        gLightBuffer.Upload();
+        gInstances.Upload();
+        gTextureLoader.Update();
+    }
+
+    // Bin the lights into clusters before the pyramid is shaded
+    if (gUseClusteredShading)
+    {
+        ProfileScope scope(gProfiler, "Cluster culling");
+        gClusterGrid.BuildBounds(projection, NEAR_PLANE, FAR_PLANE);
+        glUseProgram(clusterCullProgramId);
+        ShaderUniforms::Set(gClusterViewLoc, view);
+        glUniform2ui(gClusterLimitsLoc, ClusterGrid::CLUSTER_COUNT, gClusterGrid.Capacity());
+        gClusterGrid.Cull();
+    }
+
+    glEnable(GL_DEPTH_TEST);    // Allows for depth comparisons and to update the depth buffer
+    glBindVertexArray(gMesh.vao);   // Activate the pyramid VAO (used by pyramid and lights)    
+
+    // Bind texture
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, gTextureId);
+
+    if (gUseDeferredShading)
+    {
+        // Geometry pass: write the pyramid's position, normal, and texture color into the G-buffer
+        ProfileScope geometryScope(gProfiler, "G-buffer");
+        gGBuffer.Resize(gFramebufferWidth, gFramebufferHeight);
+        gGBuffer.BeginGeometryPass();
+        glUseProgram(gBufferProgramId);
+        ShaderUniforms::Set(gGBufferTransform.view, view);
+        ShaderUniforms::Set(gGBufferTransform.projection, projection);
+        ShaderUniforms::Set(gGBufferUVScaleLoc, gUVScale);
+        UDrawScene();
+        gProfiler.EndScope(geometryScope.Release());
+
+        // Lighting pass: shade every covered pixel once with a full-screen triangle
+        ProfileScope lightingScope(gProfiler, "Deferred lighting");
+        glBindFramebuffer(GL_FRAMEBUFFER, gTargetFramebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // Clear the frame and z buffers
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(deferredLightingProgramId);
+        USetLightingUniforms(gDeferredLighting, view);
+        gGBuffer.BindTextures(GBUFFER_TEXTURE_UNIT);
+        glBindVertexArray(gEmptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // Lamps are drawn forward, depth tested against the pyramid
+        gGBuffer.BlitDepth(gTargetFramebuffer);
+        glEnable(GL_DEPTH_TEST);
+        glBindVertexArray(gMesh.vao);
+    }
+    else
+    {
+        ProfileScope scope(gProfiler, "Pyramid");
+        glBindFramebuffer(GL_FRAMEBUFFER, gTargetFramebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // Clear the frame and z buffers
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glUseProgram(shaderProgramId);  // Set the shader to be used
+
+        // Pass transform matrices to the Shader program using the cached locations
+        ShaderUniforms::Set(gPyramidTransform.view, view);
+        ShaderUniforms::Set(gPyramidTransform.projection, projection);
+
+        // Pass lighting, camera and scale data to the Shader program
+        USetLightingUniforms(gForwardLighting, view);
+        ShaderUniforms::Set(gUVScaleLoc, gUVScale);
+
+        // Draw pyramids
+        UDrawScene();
+    }
+
+    // Draw lamps
+    if (!gVisibleLamps.empty())
+    {
+        ProfileScope scope(gProfiler, "Lamps");
+        glUseProgram(lampProgramId); // Activate shader program (every lamp uses the same shader)
+
+        // Pass matrix data to Lamp Shader program, the lamp transforms are instance attributes
+        ShaderUniforms::Set(gLampTransform.view, view);
+        ShaderUniforms::Set(gLampTransform.projection, projection);
+
+        UDrawInstances(gFirstLampInstance, (GLuint)gVisibleLamps.size()); // Draws lamps 
+    }
+
+    // Deactivate VAO and shader program
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    if (gTargetFramebuffer == 0)
+    {
+        ProfileScope scope(gProfiler, "Swap");
+        glfwSwapBuffers(gWindow);    // Swap front and back buffers of window
+    }
+}
+
+// Function holds pyramid coordinates and returns them welded into an indexed mesh (position, normal and texture
+// coordinate floats per vertex)
+IndexedMesh UBuildPyramidMesh()
+{
+    // Position and Color data
+    GLfloat verts[] = {
+       // Position (x, y, z)   // Normals (x, y, z)  // Texture (x, y)
+        -1.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,		0.0f, 0.0f,	    // Base Triangle 1 (bottom)
+        -1.0f, 0.0f,  1.0f,		0.0f, -1.0f, 0.0f,		0.0f, 1.0f,
+         1.0f, 0.0f,  1.0f,		0.0f, -1.0f, 0.0f,		1.0f, 1.0f,
+
+         1.0f, 0.0f,  1.0f,	    0.0f, -1.0f, 0.0f,		1.0f, 1.0f,	    // Base Triangle 2 (bottom)
+         1.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,		1.0f, 0.0f,
+        -1.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,		0.0f, 0.0f,
+
+        -1.0f, 0.0f, -1.0f,		-1.0f, 0.0f, 0.0f,		0.0f, 0.0f,    // Side 1 (left)
+        -1.0f, 0.0f,  1.0f,		-1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
+         0.0f, 1.0f,  0.0f,	    -1.0f, 0.0f, 0.0f,		0.5f, 1.0f,
+
+        -1.0f, 0.0f, -1.0f,		0.0f, 0.0f, -1.0f,		0.0f, 0.0f,    // Side 2 (back)
+         1.0f, 0.0f, -1.0f,		0.0f, 0.0f, -1.0f,		1.0f, 0.0f,
+         0.0f, 1.0f,  0.0f,		0.0f, 0.0f, -1.0f,		0.5f, 1.0f,
+
+         1.0f, 0.0f,  1.0f,		1.0f, 0.0f, 0.0f,		0.0f, 0.0f,    // Side 3 (right)
+         1.0f, 0.0f, -1.0f,		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,
+         0.0f, 1.0f,  0.0f,		1.0f, 0.0f, 0.0f,		0.5f, 1.0f,
+
+        -1.0f, 0.0f, 1.0f,		0.0f, 0.0f, 1.0f,		0.0f, 0.0f,     // Side 4 (front)
+         1.0f, 0.0f, 1.0f,		0.0f, 0.0f, 1.0f,		1.0f, 0.0f,
+         0.0f, 1.0f, 0.0f,		0.0f, 0.0f, 1.0f, 		0.5f, 1.0f
+    };
+    // Identify how many floats for Position, Normal, and Texture coordinates
+    const GLuint floatsPerVertex = 3;
+    const GLuint floatsPerNormal = 3;
+    const GLuint floatsPerUV = 2;
+
+    const GLuint floatsPerMeshVertex = floatsPerVertex + floatsPerNormal + floatsPerUV;
+    const size_t expandedVertices = sizeof(verts) / (sizeof(verts[0]) * floatsPerMeshVertex);
+
+    // Store corners shared by triangles with the same normal and texture coordinates once and draw through indices
+    return WeldVertices(verts, expandedVertices, floatsPerMeshVertex);
+}
+
+// Function generates/activates VAO/VBO of the pyramid, and create/enable Vertex Attribute Pointers
+void UCreateMesh(GLMesh& mesh)
+{
+    // Identify how many floats for Position, Normal, and Texture coordinates
+    const GLuint floatsPerVertex = 3;
+    const GLuint floatsPerNormal = 3;
+    const GLuint floatsPerUV = 2;
+    const GLuint floatsPerMeshVertex = floatsPerVertex + floatsPerNormal + floatsPerUV;
+
+    IndexedMesh indexed = UBuildPyramidMesh();
+    const size_t expandedVertices = indexed.indices.size();     // Welding keeps one index per authored vertex
+    VertexCacheStats authored = AnalyzeVertexCache(indexed);
+    OptimizeMesh(indexed);      // Reorder triangles and vertices for the post-transform cache and early depth rejection
+    VertexCacheStats optimized = AnalyzeVertexCache(indexed);
+    vector<unsigned char> indices = indexed.PackedIndices();
+    mesh.nVertices = (GLuint)indexed.VertexCount();
+    mesh.nIndices = (GLuint)indexed.indices.size();
+    mesh.indexType = indexed.IndexType();
+    mesh.bounds = ComputeBounds(indexed.vertices.data(), indexed.VertexCount(), indexed.floatsPerVertex);
+
+    glGenVertexArrays(1, &mesh.vao); // Create and bind Vertex Array Object
+    glBindVertexArray(mesh.vao);
+
+    // Pack the vertices to 16 bytes unless the float layout is asked for or the mesh cannot be quantized
+    vector<QuantizedVertex> quantized;
+    glm::vec3 positionOffset(0.0f);
+    float positionScale = 1.0f;
+    mesh.quantized = gUseQuantizedVertices && QuantizeVertices(indexed, quantized, positionOffset, positionScale);
+    mesh.positionTransform = glm::translate(positionOffset) * glm::scale(glm::vec3(positionScale));
+
+    glGenBuffers(1, &mesh.vbo); // Create and activate Vertex Buffer Object
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); 
+    if (mesh.quantized)
+        glBufferData(GL_ARRAY_BUFFER, quantized.size() * sizeof(QuantizedVertex), quantized.data(), GL_STATIC_DRAW);
+    else
+        glBufferData(GL_ARRAY_BUFFER, indexed.vertices.size() * sizeof(float), indexed.vertices.data(), GL_STATIC_DRAW); // Send vertex data to the GPU
+
+    glGenBuffers(1, &mesh.ibo); // Create index buffer, recorded in the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
+    cout << "Mesh: " << expandedVertices << " vertices welded to " << mesh.nVertices << ", " << mesh.nIndices
+         << (mesh.indexType == GL_UNSIGNED_SHORT ? " 16" : " 32") << " bit indices, ACMR " << authored.acmr << " -> "
+         << optimized.acmr << ", ATVR " << authored.atvr << " -> " << optimized.atvr << ", "
+         << (mesh.quantized ? sizeof(QuantizedVertex) : sizeof(float) * floatsPerMeshVertex) << " bytes per vertex" << endl;
+
+    if (mesh.quantized)
+    {
+        // snorm16 positions and octahedral normals, unorm16 texture coordinates
+        GLint packedStride = sizeof(QuantizedVertex);
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, packedStride, (void*)offsetof(QuantizedVertex, position));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, packedStride, (void*)offsetof(QuantizedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, packedStride, (void*)offsetof(QuantizedVertex, textureCoordinate));
+    }
+    else
+    {
+        // Strides between vertex coordinates
+        GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
+
+        // Create Vertex Attribute Pointers - position, normal, texture
+        glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+        glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
+        glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+}
+
+// Function to destroy VAO and VBO
+void UDestroyMesh(GLMesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.vbo);
+    glDeleteBuffers(1, &mesh.ibo);
+}
+
+// Function to create a texture and load its image in the background (a placeholder is shown until it is uploaded)
+bool UCreateTexture(const char* filename, GLuint& textureId)
+{
+    return gTextureLoader.Request(filename, textureId);
+}
+
+// Function to wait until every requested texture is uploaded, so offscreen frames show the real textures
+void UWaitForTextures()
+{
+    gTextureLoader.Finish();
+}
+
+// Function to destroy texture
+void UDestroyTexture(GLuint textureId)
+{
+    glDeleteTextures(1, &textureId);
+}
+
+// Function to create shader program, waiting for it to compile and link
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+{
+    // Create shader program object, compile and link the shaders, and print compilation and linking errors
+    programId = gProgramBuilder.Submit(vtxShaderSource, fragShaderSource);
+    if (!gProgramBuilder.Finish(programId))
+        return false;
+
+    glUseProgram(programId);    // Use shader program
+    return true;
+}
+
+// Function to insert a shader library after the #version line of a shader source
+string UInsertShaderLibrary(const char* shaderSource, const char* librarySource)
+{
+    string source(shaderSource);
+    size_t versionEnd = source.find('\n') + 1;
+    return source.insert(versionEnd, string(librarySource) + "\n");
+}
+
+// Function to create compute shader program, waiting for it to compile and link
+bool UCreateComputeProgram(const char* compShaderSource, GLuint& programId)
+{
+    programId = gProgramBuilder.SubmitCompute(compShaderSource);
+    return gProgramBuilder.Finish(programId);
+}
+
+// Function to destroy shader program
+void UDestroyShaderProgram(GLuint programId)
+{
+    glDeleteProgram(programId);
+}
+
+// Function to return the shared shader program for a vertex and fragment shader, submitting it for compilation on
+// first use (UFinishShaderPrograms must be called before the program is used)
+bool UAcquireShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+{
+    uint64_t hash = ShaderRegistry::Hash(vtxShaderSource, fragShaderSource);
+    programId = gShaderRegistry.Find(hash);
+    if (programId != 0)
+        return true;
+
+    if (!gProgramCache.Load(hash, programId))
+    {
+        programId = gProgramBuilder.Submit(vtxShaderSource, fragShaderSource);
+        gPendingPrograms.push_back({ hash, programId });
+    }
+    gShaderRegistry.Add(hash, programId);
+    return programId != 0;
+}
+
+// Function to return the shared compute shader program for a compute shader, submitting it for compilation on first use
+bool UAcquireComputeProgram(const char* compShaderSource, GLuint& programId)
+{
+    uint64_t hash = ShaderRegistry::Hash(nullptr, nullptr, compShaderSource);
+    programId = gShaderRegistry.Find(hash);
+    if (programId != 0)
+        return true;
+
+    if (!gProgramCache.Load(hash, programId))
+    {
+        programId = gProgramBuilder.SubmitCompute(compShaderSource);
+        gPendingPrograms.push_back({ hash, programId });
+    }
+    gShaderRegistry.Add(hash, programId);
+    return programId != 0;
+}
+
+// Function to wait for the submitted shader programs, storing each in the binary cache as soon as it is done
+bool UFinishShaderPrograms()
+{
+    bool success = true;
+    while (!gPendingPrograms.empty())
+    {
+        // Take the first program the driver has finished, or wait for the oldest if none is done yet
+        size_t next = 0;
+        for (size_t i = 0; i < gPendingPrograms.size(); i++)
+        {
+            if (gProgramBuilder.Ready(gPendingPrograms[i].programId))
+            {
+                next = i;
+                break;
+            }
+        }
+        PendingProgram program = gPendingPrograms[next];
+        gPendingPrograms.erase(gPendingPrograms.begin() + next);
+
+        if (gProgramBuilder.Finish(program.programId))
+            gProgramCache.Store(program.hash, program.programId);
+        else
+            success = false;
+    }
+    return success;
+}
+
+// Function to cache the uniform locations of the pyramid and lamp shader programs
+void UResolveUniforms()
+{
+    gPyramidUniforms.Reflect(shaderProgramId);
+    gPyramidTransform = { gPyramidUniforms.Location("view"), gPyramidUniforms.Location("projection") };
+    gUVScaleLoc = gPyramidUniforms.Location("uvScale");
+
+    ShaderUniforms gBufferUniforms;
+    gBufferUniforms.Reflect(gBufferProgramId);
+    gGBufferTransform = { gBufferUniforms.Location("view"), gBufferUniforms.Location("projection") };
+    gGBufferUVScaleLoc = gBufferUniforms.Location("uvScale");
+
+    ShaderUniforms deferredUniforms;
+    deferredUniforms.Reflect(deferredLightingProgramId);
+
+    // Lighting uniforms and constants shared by the forward and deferred lighting shaders
+    ShaderUniforms* lightingPrograms[2] = { &gPyramidUniforms, &deferredUniforms };
+    LightingUniforms* lightingUniforms[2] = { &gForwardLighting, &gDeferredLighting };
+    for (int i = 0; i < 2; i++)
+    {
+        const ShaderUniforms& program = *lightingPrograms[i];
+        *lightingUniforms[i] = { program.Location("viewPosition"), program.Location("view"), program.Location("useClusters"), program.Location("screenSize"), program.Location("clusterDims") };
+
+        // Cluster depth range never changes, set it once
+        glUseProgram(program.Program());
+        glUniform2f(program.Location("depthRange"), NEAR_PLANE, FAR_PLANE);
+    }
+
+    // Texture units never change, set them once
+    glUseProgram(shaderProgramId);
+    ShaderUniforms::Set(gPyramidUniforms.Location("uTexture"), 0);  // Set texture as texture unit 0
+    glUseProgram(gBufferProgramId);
+    ShaderUniforms::Set(gBufferUniforms.Location("uTexture"), 0);
+    glUseProgram(deferredLightingProgramId);
+    ShaderUniforms::Set(deferredUniforms.Location("gPositionTexture"), (int)GBUFFER_TEXTURE_UNIT);
+    ShaderUniforms::Set(deferredUniforms.Location("gNormalTexture"), (int)GBUFFER_TEXTURE_UNIT + 1);
+    ShaderUniforms::Set(deferredUniforms.Location("gAlbedoTexture"), (int)GBUFFER_TEXTURE_UNIT + 2);
+
+    ShaderUniforms clusterUniforms;
+    clusterUniforms.Reflect(clusterCullProgramId);
+    gClusterViewLoc = clusterUniforms.Location("view");
+    gClusterLimitsLoc = clusterUniforms.Location("clusterLimits");
+
+    ShaderUniforms objectCullUniforms;
+    objectCullUniforms.Reflect(objectCullProgramId);
+    gObjectCullPlanesLoc = objectCullUniforms.Location("frustumPlanes");
+    gObjectCullCountLoc = objectCullUniforms.Location("objectCount");
+    gObjectCullIndexCountLoc = objectCullUniforms.Location("indexCount");
+    gObjectCullCompactLoc = objectCullUniforms.Location("compact");
+    glUseProgram(0);
+
+    // Lamps are drawn together with one shader program
+    ShaderUniforms lampUniforms;
+    lampUniforms.Reflect(lampProgramId);
+    gLampTransform = { lampUniforms.Location("view"), lampUniforms.Location("projection") };
+}
+
+// Function to pass camera and clustered lighting data to a shader program using the lighting library
+void USetLightingUniforms(const LightingUniforms& uniforms, const glm::mat4& view)
+{
+    ShaderUniforms::Set(uniforms.viewPosition, gCamera.Position);
+    ShaderUniforms::Set(uniforms.view, view);
+    ShaderUniforms::Set(uniforms.useClusters, gUseClusteredShading ? 1 : 0);
+    ShaderUniforms::Set(uniforms.screenSize, glm::vec2((float)gFramebufferWidth, (float)gFramebufferHeight));
+    glUniform4ui(uniforms.clusterDims, ClusterGrid::TILES_X, ClusterGrid::TILES_Y, ClusterGrid::SLICES, gClusterGrid.Capacity());
+}
+
+// Function to copy the scene lights into the light buffer and the lamp models, and refit the lamps' boxes
+void UUpdateLightBuffer()
+{
+    const size_t lampCount = gSceneLights.Size();
+    const bool rebuild = gLampLeaves.size() != lampCount;
+    if (rebuild)
+    {
+        gLampTree.Clear();
+        gLampLeaves.resize(lampCount);
+    }
+    gLightBuffer.Resize(lampCount);
+    gClusterGrid.Reserve((GLuint)lampCount);   // Grow the cluster light lists so no cluster drops a light
+    gLampModels.resize(lampCount);
+    for (size_t i = 0; i < lampCount; i++)
+    {
+        const glm::vec3 position = gSceneLights.Position(i);
+        gLightBuffer.Set(i, position, gSceneLights.Color(i), gSceneLights.Intensity(i), gSceneLights.Range(i));
+
+        // Transform lights
+        gLampModels[i] = glm::translate(position) * glm::scale(gSceneLights.Scale(i));
+        AABB bounds = TransformBounds(gMesh.bounds, gLampModels[i]);
+        if (rebuild)
+            gLampLeaves[i] = gLampTree.Insert(bounds, (uint32_t)i);
+        else
+            gLampTree.Move(gLampLeaves[i], bounds);
+    }
+}
+
+// Function to rotate the scene lights about the y-axis by the angle they orbit in deltaTime
+void UOrbitLights(float deltaTime)
+{
+    const float angularVelocity = glm::radians(45.0f);
+    gSceneLights.Orbit(angularVelocity * deltaTime);
+}
+
+// Function to return the model matrix of pyramid index of count, a single pyramid at the origin or a square grid of
+// smaller ones around it
+glm::mat4 UPyramidModel(int index, int count)
+{
+    glm::mat4 rotation = glm::rotate(8.3f, glm::vec3(0.0, 1.0f, 0.0f)); // Rotate along y-axis
+    if (count == 1)
+        return rotation;
+
+    const int side = (int)ceil(sqrt((float)count));
+    const float spacing = 0.5f;
+    glm::vec3 offset(((index % side) - (side - 1) * 0.5f) * spacing, 0.0f, ((index / side) - (side - 1) * 0.5f) * spacing);
+    return glm::translate(offset) * rotation * glm::scale(glm::vec3(0.2f));
+}
+
+// Function to replace the scene objects with count pyramids without touching any GL state
+void UPlacePyramids(int count)
+{
+    gPyramidCount = count;
+    gScene.Clear();
+    for (int i = 0; i < count; i++)
+        gScene.Create(UPyramidModel(i, count), MESH_PYRAMID, MATERIAL_BRICK);
+}
+
+// Function to place count pyramids
+void UCreatePyramidInstances(int count)
+{
+    UPlacePyramids(count);
+    UUpdateLightBuffer();
+}
+
+// Function to bring the scene objects' boxes up to date and write the instances of the objects and lamps inside the
+// view frustum (all of them with culling off): one batch of objects per mesh and material, then the lamps. With GPU
+// culling every object keeps its instance and the culling shader is dispatched instead
+void UCullScene(const glm::mat4& viewProjection)
+{
+    const Frustum frustum(viewProjection);
+
+    // Lamps are culled on the CPU
+    gVisibleLamps.clear();
+    if (gUseFrustumCulling)
+        gLampTree.Query(frustum, [](uint32_t lamp) { gVisibleLamps.push_back(lamp); });
+    else
+    {
+        for (uint32_t lamp = 0; lamp < gSceneLights.Size(); lamp++)
+            gVisibleLamps.push_back(lamp);
+    }
+
+    size_t visibleObjects;
+    if (gUseGpuCulling)
+    {
+        gFirstLampInstance = UCullObjectsOnGpu(frustum);
+        visibleObjects = gGpuCulling.VisibleCount();    // From an earlier frame, the current one is not finished
+    }
+    else
+    {
+        gFirstLampInstance = UCullObjectsOnCpu(frustum);
+        visibleObjects = gVisibleObjects.size();
+    }
+
+    for (size_t i = 0; i < gVisibleLamps.size(); i++)
+        gInstances.Set(gFirstLampInstance + i, gLampModels[gVisibleLamps[i]] * gMesh.positionTransform, glm::vec4(1.0f));  // Lamps are white
+    gCullingStats = { gScene.Size(), visibleObjects, gSceneLights.Size(), gVisibleLamps.size() };
+}
+
+// Function to find the visible objects with the object tree and write their instances, returns the first lamp instance
+GLuint UCullObjectsOnCpu(const Frustum& frustum)
+{
+    const vector<glm::mat4>& models = gScene.Models();
+    const vector<uint32_t>& meshes = gScene.Meshes();
+    const vector<uint32_t>& materials = gScene.Materials();
+    const size_t objectCount = gScene.Size();
+    gGpuSceneVersion = UINT64_MAX;      // The instances no longer follow the registry order
+
+    // Refit the boxes of the objects when they moved, rebuild the tree when objects were added or removed
+    if (gScene.Version() != gSyncedSceneVersion)
+    {
+        gSyncedSceneVersion = gScene.Version();
+        const bool rebuild = gObjectLeaves.size() != objectCount;
+        if (rebuild)
+        {
+            gObjectTree.Clear();
+            gObjectLeaves.resize(objectCount);
+        }
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            AABB bounds = TransformBounds(gMesh.bounds, models[i]);     // Every object uses the pyramid mesh so far
+            if (rebuild)
+                gObjectLeaves[i] = gObjectTree.Insert(bounds, (uint32_t)i);
+            else
+                gObjectTree.Move(gObjectLeaves[i], bounds);
+        }
+    }
+
+    gVisibleObjects.clear();
+    if (gUseFrustumCulling)
+        gObjectTree.Query(frustum, [](uint32_t object) { gVisibleObjects.push_back(object); });
+    else
+    {
+        for (uint32_t object = 0; object < objectCount; object++)
+            gVisibleObjects.push_back(object);
+    }
+
+    // Counting sort of the visible objects by mesh and material
+    gInstances.Resize(gVisibleObjects.size() + gVisibleLamps.size());
+    GLuint nextInstance[MESH_COUNT * MATERIAL_COUNT] = {};
+    for (uint32_t object : gVisibleObjects)
+        nextInstance[meshes[object] * MATERIAL_COUNT + materials[object]]++;
+
+    gSceneBatches.clear();
+    GLuint firstInstance = 0;
+    for (uint32_t key = 0; key < MESH_COUNT * MATERIAL_COUNT; key++)
+    {
+        GLuint count = nextInstance[key];
+        if (count > 0)
+            gSceneBatches.push_back({ key / MATERIAL_COUNT, key % MATERIAL_COUNT, firstInstance, count });
+        nextInstance[key] = firstInstance;
+        firstInstance += count;
+    }
+
+    for (uint32_t object : gVisibleObjects)
+    {
+        GLuint instance = nextInstance[meshes[object] * MATERIAL_COUNT + materials[object]]++;
+        gInstances.Set(instance, models[object] * gMesh.positionTransform, glm::vec4(1.0f));  // Set model matrix
+    }
+    return firstInstance;
+}
+
+// Function to write every object's bounds and instance when the scene changed and dispatch the object culling shader,
+// returns the first lamp instance
+GLuint UCullObjectsOnGpu(const Frustum& frustum)
+{
+    const vector<glm::mat4>& models = gScene.Models();
+    const size_t objectCount = gScene.Size();
+
+    // Object i is instance i, every lamp has room after them so lamp culling never resizes the buffer
+    gInstances.Resize(objectCount + gSceneLights.Size());
+    if (gScene.Version() != gGpuSceneVersion)
+    {
+        gGpuSceneVersion = gScene.Version();
+        gObjectBounds.resize(objectCount);
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            AABB bounds = TransformBounds(gMesh.bounds, models[i]);     // Every object uses the pyramid mesh so far
+            gObjectBounds[i] = { glm::vec4(bounds.low, 1.0f), glm::vec4(bounds.high, 1.0f) };
+            gInstances.Set(i, models[i] * gMesh.positionTransform, glm::vec4(1.0f));  // Set model matrix
+        }
+        gGpuCulling.SetObjects(gObjectBounds);
+    }
+
+    // Planes every box is in front of when culling is off
+    glm::vec4 planes[6];
+    for (int i = 0; i < 6; i++)
+        planes[i] = gUseFrustumCulling ? frustum.Planes()[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    glUseProgram(objectCullProgramId);
+    glUniform4fv(gObjectCullPlanesLoc, 6, glm::value_ptr(planes[0]));
+    glUniform1ui(gObjectCullCountLoc, (GLuint)objectCount);
+    glUniform1ui(gObjectCullIndexCountLoc, gMesh.nIndices);
+    ShaderUniforms::Set(gObjectCullCompactLoc, GpuCulling::DrawCountSupported() ? 1 : 0);
+    gGpuCulling.Cull();
+    return (GLuint)objectCount;
+}
+
+// Function to draw every scene object with the active shader program, one instanced draw call per batch (the pyramid
+// mesh and the brick material are the only ones so far, so each batch only needs its range of instances), or one
+// indirect multi-draw of the commands written by the object culling shader
+void UDrawScene()
+{
+    if (gUseGpuCulling)
+    {
+        gGpuCulling.Draw(gMesh.indexType);
+        return;
+    }
+    for (const SceneBatch& batch : gSceneBatches)
+        UDrawInstances(batch.firstInstance, batch.count);
+}
+
+// Function to draw a range of instances with one instanced draw call, or with one draw call per instance
+void UDrawInstances(GLuint firstInstance, GLuint count)
+{
+    if (gUseInstancing)
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, gMesh.nIndices, gMesh.indexType, nullptr, count, firstInstance);
+    else
+    {
+        for (GLuint i = 0; i < count; i++)
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, gMesh.nIndices, gMesh.indexType, nullptr, 1, firstInstance + i);
+    }
+}
+
+// Function to replace the scene lights with small, randomly placed lights around the pyramid
+void UCreateRandomLights(int count, unsigned seed)
+{
+    UPlaceRandomLights(count, seed);
+    UResolveUniforms();
+    UUpdateLightBuffer();
+}
+
+// Function to replace the scene lights without touching any GL state
+void UPlaceRandomLights(int count, unsigned seed)
+{
+    mt19937 random(seed);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    gSceneLights.Clear();
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 position(unit(random) * 8.0f - 4.0f, unit(random) * 2.0f, unit(random) * 8.0f - 4.0f);
+        glm::vec3 color(unit(random), unit(random), unit(random));
+        gSceneLights.Add({ position, glm::vec3(0.05f), color, 0.1f, 1.5f });
+    }
+}
+
+// Function to time naive and clustered lighting as the number of lights grows
+void ULightSweepBenchmark()
+{
+    UWaitForTextures();
+
+    const int framesPerRun = 100;
+    const SceneLights sceneLights = gSceneLights;
+    const bool wasClustered = gUseClusteredShading;
+
+    if (gWindow != nullptr)
+        glfwSwapInterval(0);    // Do not let vsync cap the frame rate
+
+    cout << setw(8) << "lights" << setw(20) << "naive ms/frame" << setw(22) << "clustered ms/frame" << setw(20) << "dropped lights" << endl;
+    for (int lightCount = 2; lightCount <= 1024; lightCount *= 2)
+    {
+        UCreateRandomLights(lightCount, 1234);
+
+        double msPerFrame[2];
+        GLuint droppedLights = 0;
+        for (int mode = 0; mode < 2; mode++)
+        {
+            gUseClusteredShading = mode == 1;
+            URender();      // Warm up
+            glFinish();
+
+            auto start = chrono::steady_clock::now();
+            for (int frame = 0; frame < framesPerRun; frame++)
+                URender();
+            glFinish();
+            msPerFrame[mode] = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / framesPerRun;
+
+            // Lights left out of full clusters make the clustered frames cheaper than the naive ones, count them
+            if (gUseClusteredShading)
+                gClusterGrid.OverflowingClusters(droppedLights);
+        }
+        cout << setw(8) << lightCount << fixed << setprecision(3) << setw(20) << msPerFrame[0] << setw(22) << msPerFrame[1] << setw(20) << droppedLights << endl;
+    }
+
+    // Restore the scene
+    gSceneLights = sceneLights;
+    gUseClusteredShading = wasClustered;
+    UResolveUniforms();
+    UUpdateLightBuffer();
+}
+
+// Function to time the pyramids and lamps drawn with one instanced draw call each against one draw call per object
+void UDrawCallBenchmark(int pyramidCount)
+{
+    UWaitForTextures();
+
+    const int framesPerRun = 20;
+    const int previousPyramidCount = gPyramidCount;
+    const bool wasInstanced = gUseInstancing;
+
+    if (gWindow != nullptr)
+        glfwSwapInterval(0);    // Do not let vsync cap the frame rate
+
+    UCreatePyramidInstances(pyramidCount);
+
+    cout << setw(12) << "mode" << setw(14) << "draw calls" << setw(14) << "ms/frame" << endl;
+    for (int mode = 0; mode < 2; mode++)
+    {
+        gUseInstancing = mode == 0;
+        URender();      // Warm up
+        glFinish();
+        const size_t drawCalls = gUseInstancing ? gSceneBatches.size() + 1 : gCullingStats.visibleObjects + gCullingStats.visibleLamps;
+
+        auto start = chrono::steady_clock::now();
+        for (int frame = 0; frame < framesPerRun; frame++)
+            URender();
+        glFinish();
+        double msPerFrame = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / framesPerRun;
+        cout << setw(12) << (gUseInstancing ? "instanced" : "per object") << setw(14) << drawCalls
+             << fixed << setprecision(3) << setw(14) << msPerFrame << endl;
+    }
+
+    // Restore the scene
+    gUseInstancing = wasInstanced;
+    UCreatePyramidInstances(previousPyramidCount);
+}
+
+// Function to compare texture upload throughput of glTexSubImage2D from client memory against streaming the same pixels
+// through the persistently mapped upload ring, both into the same preallocated texture so only the upload path differs
+void UTextureUploadBenchmark()
+{
+    const int size = 2048;
+    const int uploads = 32;
+    const size_t imageBytes = (size_t)size * size * 4;
+
+    vector<unsigned char> pixels(imageBytes);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (unsigned char)(i * 7);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    PixelUploadRing ring;
+    if (!ring.Create(TextureLoader::UPLOAD_SEGMENT_SIZE))
+    {
+        cout << "Failed to map the upload ring" << endl;
+        glDeleteTextures(1, &texture);
+        return;
+    }
+
+    cout << "Uploading " << uploads << " " << size << "x" << size << " RGBA8 images" << endl;
+    cout << setw(28) << "path" << setw(12) << "MB/s" << endl;
+    for (int mode = 0; mode < 2; mode++)
+    {
+        const bool streamed = mode == 1;
+        auto upload = [&]()
+        {
+            if (streamed)
+                UploadThroughRing(ring, pixels.data(), size, size, GL_RGBA, 4);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        };
+        upload();       // Warm up
+        glFinish();
+
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < uploads; i++)
+            upload();
+        glFinish();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << setw(28) << (streamed ? "PBO ring glTexSubImage2D" : "client glTexSubImage2D") << fixed << setprecision(1)
+             << setw(12) << imageBytes * uploads / 1.0e6 / seconds << endl;
+    }
+    cout << "Upload ring stalls: " << ring.Stalls() << endl;
+
+    ring.Destroy();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture);
+}
+
+// Function to load the scene texture count times at once and report the time taken and how far the peak resident
+// memory rose. The peak never falls, so compare separate runs with and without gMapTextureFiles
+void UTextureLoadBenchmark(int count)
+{
+    UWaitForTextures();
+    const size_t peakBefore = PeakResidentBytes();
+
+    vector<GLuint> textures(count, 0);
+    auto start = chrono::steady_clock::now();
+    for (GLuint& texture : textures)
+        UCreateTexture(gTextureFilename, texture);
+    UWaitForTextures();
+    glFinish();
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    const size_t peakAfter = PeakResidentBytes();
+
+    cout << "Loaded " << count << " x " << gTextureFilename << (gMapTextureFiles ? " mapped" : " read with stdio") << " in "
+         << fixed << setprecision(1) << milliseconds << " ms" << endl;
+    cout << "Peak RSS before load: " << peakBefore / 1.0e6 << " MB, after: " << peakAfter / 1.0e6 << " MB (+"
+         << (peakAfter - peakBefore) / 1.0e6 << " MB)" << endl;
+
+    for (GLuint texture : textures)
+        UDestroyTexture(texture);
+}
+
+// Function to time the CPU mip chain kernels against the per texel reference and glGenerateMipmap, in source Mpixels/s
+void UMipmapBenchmark()
+{
+    const int size = 2048;
+    const int runs = 5;
+
+    vector<unsigned char> pixels((size_t)size * size * 4);
+    mt19937 random(1234);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (unsigned char)((i / 4 % size + (i / 4 / size) * 3 + random() % 64) & 0xFF);
+
+    // Best of several runs in Mpixels of level 0 per second
+    auto measure = [&](auto generate)
+    {
+        double best = 1.0e30;
+        for (int run = 0; run < runs; run++)
+        {
+            auto start = chrono::steady_clock::now();
+            generate();
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        return (double)size * size / 1.0e6 / best;
+    };
+
+    cout << "Mip chains of a " << size << "x" << size << " RGBA8 image, " << MipSimdName() << " kernels" << endl;
+    cout << setw(10) << "filter" << setw(8) << "sRGB" << setw(16) << "reference" << setw(16) << "kernels" << setw(10) << "max diff" << endl;
+    for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser })
+    {
+        for (bool srgb : { false, true })
+        {
+            vector<MipLevel> kernelLevels, referenceLevels;
+            double reference = measure([&] { referenceLevels = mipmap_reference::GenerateMipChain(pixels.data(), size, size, 4, filter, srgb); });
+            double kernels = measure([&] { kernelLevels = GenerateMipChain(pixels.data(), size, size, 4, filter, srgb); });
+
+            int maxDifference = 0;
+            for (size_t level = 0; level < kernelLevels.size(); level++)
+                for (size_t i = 0; i < kernelLevels[level].pixels.size(); i++)
+                    maxDifference = max(maxDifference, abs(kernelLevels[level].pixels[i] - referenceLevels[level].pixels[i]));
+
+            cout << setw(10) << (filter == MipFilter::Box ? "box" : "kaiser") << setw(8) << (srgb ? "yes" : "no") << fixed << setprecision(1)
+                 << setw(16) << reference << setw(16) << kernels << setw(10) << maxDifference << endl;
+        }
+    }
+
+    // The driver's box filter on the same image for comparison
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    double generateMipmap = measure([] { glGenerateMipmap(GL_TEXTURE_2D); glFinish(); });
+    cout << "glGenerateMipmap: " << generateMipmap << " Mpixels/s" << endl;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture);
+}
+
+// Function to report the vertex cache statistics of a large sphere at each step of the mesh optimizer, starting from a
+// random triangle order like a poorly exported asset
+void UMeshOptimizationBenchmark()
+{
+    const int rings = 256;
+    const int segments = 512;
+
+    // Expanded sphere triangles with the pyramid's position, normal and texture coordinate layout
+    vector<float> expanded;
+    auto addVertex = [&](int ring, int segment)
+    {
+        float theta = glm::radians(180.0f) * ring / rings, phi = glm::radians(360.0f) * segment / segments;
+        glm::vec3 normal(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+        float vertex[8] = { normal.x, normal.y, normal.z, normal.x, normal.y, normal.z, (float)segment / segments, (float)ring / rings };
+        expanded.insert(expanded.end(), vertex, vertex + 8);
+    };
+    for (int ring = 0; ring < rings; ring++)
+    {
+        for (int segment = 0; segment < segments; segment++)
+        {
+            addVertex(ring, segment); addVertex(ring + 1, segment); addVertex(ring + 1, segment + 1);
+            addVertex(ring, segment); addVertex(ring + 1, segment + 1); addVertex(ring, segment + 1);
+        }
+    }
+    IndexedMesh mesh = WeldVertices(expanded.data(), expanded.size() / 8, 8);
+
+    vector<uint32_t> triangles(mesh.indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); t++)
+        triangles[t] = (uint32_t)t;
+    shuffle(triangles.begin(), triangles.end(), mt19937(1234));
+    vector<uint32_t> shuffled;
+    shuffled.reserve(mesh.indices.size());
+    for (uint32_t t : triangles)
+        shuffled.insert(shuffled.end(), mesh.indices.begin() + t * 3, mesh.indices.begin() + t * 3 + 3);
+
+    cout << "Sphere of " << mesh.indices.size() / 3 << " triangles and " << mesh.VertexCount() << " vertices, 16 entry FIFO cache" << endl;
+    cout << setw(16) << "order" << setw(10) << "ACMR" << setw(10) << "ATVR" << setw(12) << "ms" << endl;
+    auto report = [&](const char* order, double milliseconds)
+    {
+        VertexCacheStats stats = AnalyzeVertexCache(mesh);
+        cout << setw(16) << order << fixed << setprecision(3) << setw(10) << stats.acmr << setw(10) << stats.atvr
+             << setprecision(1) << setw(12) << milliseconds << endl;
+    };
+    auto time = [](auto step)
+    {
+        auto start = chrono::steady_clock::now();
+        step();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    report("grid", 0.0);
+    mesh.indices = shuffled;
+    report("shuffled", 0.0);
+    report("vertex cache", time([&] { OptimizeVertexCache(mesh); }));
+    report("overdraw", time([&] { OptimizeOverdraw(mesh); }));
+    report("vertex fetch", time([&] { OptimizeVertexFetch(mesh); }));
+}
+
+// Function to time the light orbit of a million lights stored as before, one glm::rotate matrix per light, against the
+// structure of arrays updated by the scalar and SIMD kernels
+void ULightOrbitBenchmark()
+{
+    const int lightCount = 1000000;
+    const int updates = 100;
+    const float angle = glm::radians(45.0f) / 60.0f;     // One frame at 60 frames per second
+
+    // The light layout before SceneLights, a program handle interleaved with every light's attributes
+    struct InterleavedLight
+    {
+        GLuint shaderProgram;
+        glm::vec3 lightPosition;
+        glm::vec3 lightScale;
+        glm::vec3 lightColor;
+        float lightIntensity;
+        float lightRange;
+    };
+
+    mt19937 random(1234);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    vector<InterleavedLight> interleaved(lightCount);
+    SceneLights lights;
+    vector<float> restX(lightCount), restZ(lightCount), x(lightCount), z(lightCount);
+    for (int i = 0; i < lightCount; i++)
+    {
+        glm::vec3 position(unit(random) * 8.0f - 4.0f, unit(random) * 2.0f, unit(random) * 8.0f - 4.0f);
+        glm::vec3 color(unit(random), unit(random), unit(random));
+        interleaved[i] = { 0, position, glm::vec3(0.05f), color, 0.1f, 1.5f };
+        lights.Add({ position, glm::vec3(0.05f), color, 0.1f, 1.5f });
+        restX[i] = position.x;
+        restZ[i] = position.z;
+    }
+
+    // Average milliseconds per update
+    auto time = [&](auto update)
+    {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < updates; i++)
+            update(i);
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / updates;
+    };
+    double interleavedMilliseconds = time([&](int)
+    {
+        for (InterleavedLight& light : interleaved)
+        {
+            glm::vec4 newPosition = glm::rotate(angle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(light.lightPosition, 1.0f);
+            light.lightPosition[0] = newPosition.x;
+            light.lightPosition[1] = newPosition.y;
+            light.lightPosition[2] = newPosition.z;
+        }
+    });
+    double scalarMilliseconds = time([&](int i) { OrbitPositionsScalar(restX.data(), restZ.data(), x.data(), z.data(), lightCount, angle * (i + 1)); });
+    double simdMilliseconds = time([&](int) { lights.Orbit(angle); });
+
+    // The kernels differ only by the rounding of the accumulated angle, the matrices drift a little as each update
+    // rotates the previous result
+    float kernelDifference = 0.0f, interleavedDifference = 0.0f;
+    for (int i = 0; i < lightCount; i++)
+    {
+        glm::vec3 position = lights.Position(i);
+        kernelDifference = max(kernelDifference, max(abs(position.x - x[i]), abs(position.z - z[i])));
+        interleavedDifference = max(interleavedDifference, glm::length(position - interleaved[i].lightPosition));
+    }
+
+    cout << "Orbit of " << lightCount << " lights, average of " << updates << " updates" << endl;
+    cout << setw(24) << "layout" << setw(12) << "ms/update" << setw(12) << "Mlights/s" << endl;
+    auto report = [&](const string& layout, double milliseconds)
+    {
+        cout << setw(24) << layout << fixed << setprecision(3) << setw(12) << milliseconds << setprecision(1)
+             << setw(12) << lightCount / 1000.0 / milliseconds << endl;
+    };
+    report("interleaved glm", interleavedMilliseconds);
+    report("SoA scalar", scalarMilliseconds);
+    report(string("SoA ") + OrbitSimdName(), simdMilliseconds);
+    cout << scientific << setprecision(2) << "Max difference: " << kernelDifference << " scalar to " << OrbitSimdName()
+         << ", " << interleavedDifference << " interleaved to SoA" << endl;
+    cout << defaultfloat;
+}
+
+// Function to time building, refitting and querying the object tree for grids of 10k to 1M pyramids seen from the
+// camera, against testing every object's box
+void UCullingBenchmark()
+{
+    const int frames = 20;
+
+    IndexedMesh pyramid = UBuildPyramidMesh();
+    const AABB meshBounds = ComputeBounds(pyramid.vertices.data(), pyramid.VertexCount(), pyramid.floatsPerVertex);
+    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
+    const Frustum frustum(projection * gCamera.GetViewMatrix());
+
+    auto milliseconds = [](chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    cout << "Frustum culling of pyramid grids, average of " << frames << " frames that each move 1% of the pyramids" << endl;
+    cout << setw(10) << "objects" << setw(10) << "visible" << setw(10) << "culled" << setw(8) << "height" << setw(12) << "build ms"
+         << setw(12) << "refit ms" << setw(12) << "query ms" << setw(14) << "every box ms" << endl;
+    for (int count : { 10000, 100000, 1000000 })
+    {
+        vector<AABB> bounds(count);
+        for (int i = 0; i < count; i++)
+            bounds[i] = TransformBounds(meshBounds, UPyramidModel(i, count));
+
+        AABBTree tree;
+        vector<int32_t> leaves(count);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+            leaves[i] = tree.Insert(bounds[i], (uint32_t)i);
+        double buildMilliseconds = milliseconds(start);
+
+        mt19937 random(1234);
+        vector<uint32_t> visible;
+        visible.reserve(count);
+        size_t everyBoxVisible = 0;
+        double refitMilliseconds = 0.0, queryMilliseconds = 0.0, everyBoxMilliseconds = 0.0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            // Bob pyramids up and down
+            const float height = frame % 2 == 0 ? 0.1f : -0.1f;
+            start = chrono::steady_clock::now();
+            for (int moved = 0; moved < count / 100; moved++)
+            {
+                int i = random() % count;
+                bounds[i].low.y += height;
+                bounds[i].high.y += height;
+                tree.Move(leaves[i], bounds[i]);
+            }
+            refitMilliseconds += milliseconds(start);
+
+            start = chrono::steady_clock::now();
+            visible.clear();
+            tree.Query(frustum, [&](uint32_t object) { visible.push_back(object); });
+            queryMilliseconds += milliseconds(start);
+
+            start = chrono::steady_clock::now();
+            everyBoxVisible = 0;
+            for (const AABB& box : bounds)
+                everyBoxVisible += frustum.Test(box) != Frustum::Containment::Outside;
+            everyBoxMilliseconds += milliseconds(start);
+        }
+
+        cout << setw(10) << count << setw(10) << visible.size() << setw(10) << count - visible.size() << setw(8) << tree.Height()
+             << fixed << setprecision(3) << setw(12) << buildMilliseconds << setw(12) << refitMilliseconds / frames
+             << setw(12) << queryMilliseconds / frames << setw(14) << everyBoxMilliseconds / frames << endl;
+        if (everyBoxVisible != visible.size())
+            cout << "Tree found " << visible.size() << " visible pyramids, testing every box found " << everyBoxVisible << endl;
+    }
+}
+
+// Function to check the GPU cluster light lists against the CPU reference implementation
+bool UValidateClusters()
+{
+    const SceneLights sceneLights = gSceneLights;
+    const bool wasClustered = gUseClusteredShading;
+
+    UCreateRandomLights(256, 4321);
+    gUseClusteredShading = true;
+    URender();
+
+    GLuint mismatches = gClusterGrid.Validate(gLightBuffer.Lights(), gCamera.GetViewMatrix());
+    GLuint droppedLights = 0;
+    GLuint overflowing = gClusterGrid.OverflowingClusters(droppedLights);
+    cout << "Cluster validation: " << mismatches << " of " << ClusterGrid::CLUSTER_COUNT << " clusters differ from the CPU reference, "
+         << overflowing << " dropped " << droppedLights << " lights that did not fit" << endl;
+
+    gSceneLights = sceneLights;
+    gUseClusteredShading = wasClustered;
+    UResolveUniforms();
+    UUpdateLightBuffer();
+    return mismatches == 0 && overflowing == 0;
+}
+
+// Function to render one frame forward and one deferred into an offscreen framebuffer and compare the pixels
+bool UCompareRenderModes()
+{
+    UWaitForTextures();
+
+    RenderTarget target;
+    if (!target.Create(gFramebufferWidth, gFramebufferHeight))
+    {
+        cout << "Failed to create offscreen framebuffer" << endl;
+        target.Destroy();
+        return false;
+    }
+
+    const bool wasDeferred = gUseDeferredShading;
+    const bool wasOrbiting = gIsLampOrbiting;
+    gIsLampOrbiting = false;    // Render the same scene in both modes
+    const GLuint targetFramebuffer = gTargetFramebuffer;
+    gTargetFramebuffer = target.Framebuffer();
+
+    vector<unsigned char> forwardPixels, deferredPixels;
+    gUseDeferredShading = false;
+    URender();
+    target.ReadPixels(forwardPixels);
+    gUseDeferredShading = true;
+    URender();
+    target.ReadPixels(deferredPixels);
+
+    size_t differingPixels = 0;
+    int maxDifference = 0;
+    for (size_t i = 0; i < forwardPixels.size(); i += 4)
+    {
+        bool differs = false;
+        for (size_t channel = i; channel < i + 4; channel++)
+        {
+            int difference = abs(forwardPixels[channel] - deferredPixels[channel]);
+            maxDifference = max(maxDifference, difference);
+            differs = differs || difference != 0;
+        }
+        if (differs)
+            differingPixels++;
+    }
+    cout << "Forward vs deferred: " << differingPixels << " of " << forwardPixels.size() / 4 << " pixels differ, largest channel difference " << maxDifference << endl;
+
+    gTargetFramebuffer = targetFramebuffer;
+    gUseDeferredShading = wasDeferred;
+    gIsLampOrbiting = wasOrbiting;
+    target.Destroy();
+
+    // Both passes run the same lighting code on the same 32 bit float inputs, so every pixel must match
+    return maxDifference == 0;
+}
+
+// Function to render frames into the offscreen framebuffer and optionally save the last one
+bool URunHeadless(const RenderTarget& target, int frameCount, const char* outputFilename)
+{
+    UWaitForTextures();
+
+    auto start = chrono::steady_clock::now();
+    auto lastFrame = start;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        auto currentFrame = chrono::steady_clock::now();
+        gDeltaTime = chrono::duration<float>(currentFrame - lastFrame).count();
+        lastFrame = currentFrame;
+
+        URender();
+    }
+    glFinish();
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Rendered " << frameCount << " headless frames in " << milliseconds << " ms" << endl;
+
+    if (outputFilename != nullptr)
+    {
+        vector<unsigned char> pixels;
+        target.ReadPixels(pixels);
+        if (!WritePPM(outputFilename, pixels, target.Width(), target.Height()))
+        {
+            cout << "Failed to write " << outputFilename << endl;
+            return false;
+        }
+        cout << "Wrote " << outputFilename << endl;
+    }
+    return true;
+}
+
+// Function to render a fixed number of frames with a fixed timestep and report frame time percentiles
+bool URunBenchmark(int frameCount, float timestep, const char* outputFilename)
+{
+    if (frameCount <= 0)
+    {
+        cout << "Benchmark needs at least one frame" << endl;
+        return false;
+    }
+    if (gWindow != nullptr)
+        glfwSwapInterval(0);    // Do not let vsync cap the frame rate
+
+    // Every run animates the same way regardless of how long frames take
+    gDeltaTime = timestep;
+    UWaitForTextures();
+
+    FrameBenchmark benchmark;
+    benchmark.Begin(frameCount);
+    size_t visibleObjects = 0, visibleLamps = 0;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        benchmark.BeginFrame();
+        URender();
+        benchmark.EndFrame();
+        visibleObjects += gCullingStats.visibleObjects;
+        visibleLamps += gCullingStats.visibleLamps;
+
+        if (gWindow != nullptr)
+            glfwPollEvents();
+    }
+    benchmark.Finish();
+
+    const FrameTimeStats& cpu = benchmark.CpuStats();
+    const FrameTimeStats& gpu = benchmark.GpuStats();
+    cout << fixed << setprecision(3);
+    cout << "Benchmark: " << benchmark.FrameCount() << " frames, timestep " << timestep << " s" << endl;
+    cout << "  CPU ms  p50 " << cpu.p50 << "  p95 " << cpu.p95 << "  p99 " << cpu.p99 << "  max " << cpu.max << endl;
+    cout << "  GPU ms  p50 " << gpu.p50 << "  p95 " << gpu.p95 << "  p99 " << gpu.p99 << "  max " << gpu.max << endl;
+    cout << setprecision(1) << "  Visible per frame: " << (double)visibleObjects / frameCount << " of " << gCullingStats.objects
+         << " pyramids, " << (double)visibleLamps / frameCount << " of " << gCullingStats.lamps << " lamps" << endl;
+
+    if (outputFilename != nullptr)
+    {
+        string description = string(gUseDeferredShading ? "deferred" : "forward") + (gUseClusteredShading ? " clustered" : " naive")
+            + ", " + to_string(gSceneLights.Size()) + " lights, timestep " + to_string(timestep) + " s";
+        if (!benchmark.Write(outputFilename, description))
+        {
+            cout << "Failed to write " << outputFilename << endl;
+            return false;
+        }
+        cout << "Wrote " << outputFilename << endl;
+    }
+    return true;
+}
+
+// Function to render frames on the CPU with the software rasterizer, report frame times and triangle and pixel
+// throughput, and optionally save the last frame. Needs no OpenGL context
+bool URunSoftwareRenderer(int frameCount, float timestep, const char* outputFilename)
+{
+    if (frameCount <= 0)
+    {
+        cout << "Software renderer needs at least one frame" << endl;
+        return false;
+    }
+
+    // The CPU samples the decoded image (cooked KTX2 files hold GPU block compressed texels)
+    int textureWidth = 0, textureHeight = 0, textureChannels = 0;
+    unsigned char* image = stbi_load("brick.jpg", &textureWidth, &textureHeight, &textureChannels, 4);
+    if (image == nullptr)
+    {
+        cout << "Failed to load texture brick.jpg" << endl;
+        return false;
+    }
+    SoftwareTexture texture;
+    texture.Create(image, textureWidth, textureHeight);
+    stbi_image_free(image);
+
+    // The same welded and optimized vertices the GL renderer uploads, kept as floats
+    IndexedMesh mesh = UBuildPyramidMesh();
+    OptimizeMesh(mesh);
+
+    SoftwareRasterizer rasterizer;
+    if (!rasterizer.Create(gFramebufferWidth, gFramebufferHeight))
+    {
+        cout << "Software renderer cannot render " << gFramebufferWidth << "x" << gFramebufferHeight << " frames" << endl;
+        return false;
+    }
+
+    UPlacePyramids(gPyramidCount);
+    const vector<glm::mat4>& pyramidModels = gScene.Models();
+    vector<glm::mat4> lampModels;
+    vector<glm::vec4> lampColors;
+    vector<SoftwareLight> lights;
+
+    // Every run animates the same way regardless of how long frames take
+    gDeltaTime = timestep;
+    vector<double> frameMilliseconds(frameCount);
+    size_t triangles = 0, pixels = 0;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        auto frameStart = chrono::steady_clock::now();
+        if (gIsLampOrbiting)
+            UOrbitLights(gDeltaTime);
+
+        lights.clear();
+        lampModels.clear();
+        lampColors.clear();
+        for (size_t i = 0; i < gSceneLights.Size(); i++)
+        {
+            const glm::vec3 position = gSceneLights.Position(i);
+            lights.push_back({ position, gSceneLights.Color(i), gSceneLights.Intensity(i), gSceneLights.Range(i) });
+            lampModels.push_back(glm::translate(position) * glm::scale(gSceneLights.Scale(i)));
+            lampColors.push_back(glm::vec4(1.0f));  // Lamps are white
+        }
+
+        glm::mat4 view = gCamera.GetViewMatrix();
+        glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
+        rasterizer.BeginFrame(projection * view, gCamera.Position, lights);
+        rasterizer.DrawLit(mesh, pyramidModels, texture, gUVScale);
+        rasterizer.DrawFlat(mesh, lampModels, lampColors);
+        rasterizer.EndFrame();
+
+        frameMilliseconds[frame] = chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count();
+        triangles += rasterizer.Stats().triangles;
+        pixels += rasterizer.Stats().pixels;
+    }
+
+    double totalMilliseconds = 0.0;
+    for (double milliseconds : frameMilliseconds)
+        totalMilliseconds += milliseconds;
+    const FrameTimeStats cpu = FrameBenchmark::ComputeStats(frameMilliseconds);
+    cout << fixed << setprecision(3);
+    cout << "Software renderer: " << frameCount << " frames at " << gFramebufferWidth << "x" << gFramebufferHeight << " on "
+         << rasterizer.ThreadCount() << " threads (" << SoftwareRasterizer::SimdName() << "), " << gPyramidCount << " pyramids, "
+         << gSceneLights.Size() << " lights" << endl;
+    cout << "  CPU ms  p50 " << cpu.p50 << "  p95 " << cpu.p95 << "  p99 " << cpu.p99 << "  max " << cpu.max << endl;
+    cout << setprecision(2) << "  " << triangles / (totalMilliseconds * 1000.0) << " Mtris/s, " << pixels / (totalMilliseconds * 1000.0)
+         << " Mpix/s, " << 1000.0 / cpu.mean << " frames/s" << endl;
+
+    bool success = true;
+    if (outputFilename != nullptr)
+    {
+        vector<unsigned char> framePixels;
+        rasterizer.ReadPixels(framePixels);
+        success = WritePPM(outputFilename, framePixels, gFramebufferWidth, gFramebufferHeight);
+        cout << (success ? "Wrote " : "Failed to write ") << outputFilename << endl;
+    }
+    rasterizer.Destroy();
+    return success;
+}
@@ -0,0 +1,188 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <GL/glew.h>        // GLEW library
+#include <GLFW/glfw3.h>     // GLFW library
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "camera.h" // Camera class
+#include "light_buffer.h" // Scene light storage buffer
+#include "clusters.h" // Clustered light culling
+#include "render_target.h" // Offscreen framebuffer
+#include "profiler.h" // Per-stage CPU/GPU profiler
+#include "indexed_mesh.h" // Welded mesh data
+#include "scene_lights.h" // Scene light storage
+#include "scene_registry.h" // Scene objects
+#include "aabb_tree.h" // Bounding volume hierarchy for frustum culling
+
+// Scene, shaders and render functions shared by the Pyramid application and the pyramid_bench executable. The
+// application owns the window and input, the renderer owns everything that is drawn
+
+// window variables
+const int WINDOW_WIDTH = 800;
+const int WINDOW_HEIGHT = 600;
+
+// Projection near and far planes
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// Meshes and materials scene objects refer to
+const uint32_t MESH_PYRAMID = 0;
+const uint32_t MESH_COUNT = 1;
+const uint32_t MATERIAL_BRICK = 0;      // Brick texture lit by the scene lights
+const uint32_t MATERIAL_COUNT = 1;
+
+// Store mesh data
+struct GLMesh
+{
+    GLuint vao;         // Handle for vertex array object
+    GLuint vbo;         // Handle for  vertex buffer object
+    GLuint ibo;         // Handle for index buffer object
+    GLuint nVertices;   // Number of unique vertices of the mesh
+    GLuint nIndices;    // Number of indices of the mesh
+    GLenum indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    bool quantized;     // Vertices are QuantizedVertex rather than 8 floats
+    glm::mat4 positionTransform;    // Maps stored positions to model space, applied to every instance's model matrix
+    AABB bounds;        // Model space bounds of the vertices
+};
+
+// Scene objects and lamps in the last frame, and how many of them were inside the view frustum
+struct CullingStats
+{
+    size_t objects;
+    size_t visibleObjects;
+    size_t lamps;
+    size_t visibleLamps;
+};
+
+// Uniform locations of the transform matrices used by the pyramid and lamp shaders (model matrices are instance
+// attributes)
+struct TransformUniforms
+{
+    GLint view;
+    GLint projection;
+};
+
+// Uniform locations used by the lighting shader library
+struct LightingUniforms
+{
+    GLint viewPosition;
+    GLint view;
+    GLint useClusters;
+    GLint screenSize;
+    GLint clusterDims;
+};
+
+// Window frames are presented to (nullptr when rendering headless)
+extern GLFWwindow* gWindow;
+
+// Triangle mesh data
+extern GLMesh gMesh;
+// Texture and scale
+extern GLuint gTextureId;
+extern glm::vec2 gUVScale;
+
+// Light data that is passed to CalcPointLight, one array per attribute
+extern SceneLights gSceneLights;
+// Scene lights packed for the pyramid shader
+extern LightBuffer gLightBuffer;
+// Clustered lighting: lights are binned into clusters by a compute shader so fragments only shade nearby lights
+extern ClusterGrid gClusterGrid;
+extern bool gUseClusteredShading;
+// Deferred shading: the pyramid is written to a G-buffer and lit by a full-screen pass
+extern bool gUseDeferredShading;
+
+// Framebuffer that frames are rendered into (0 for the window)
+extern GLuint gTargetFramebuffer;
+// Framebuffer size, updated when the window is resized
+extern int gFramebufferWidth;
+extern int gFramebufferHeight;
+
+// Per-stage CPU and GPU timing of URender
+extern Profiler gProfiler;
+
+// Define camera position
+extern Camera gCamera;
+// Time simulated by the current frame
+extern float gDeltaTime;
+
+// Objects drawn in the scene, with their transform, mesh and material
+extern SceneRegistry gScene;
+
+// Orbit lights around scene / pyramid
+extern bool gIsLampOrbiting;
+
+// Directory linked shader programs are cached in between runs (nullptr to always compile)
+extern const char* gShaderCacheDirectory;
+
+// Memory map texture files instead of reading them with stdio
+extern bool gMapTextureFiles;
+
+// Pack mesh vertices into 16 bytes instead of 8 floats
+extern bool gUseQuantizedVertices;
+
+// Number of pyramids drawn (1 unless a stress test asks for more)
+extern int gPyramidCount;
+// Draw all pyramids and all lamps with one instanced draw call each instead of one draw call per object
+extern bool gUseInstancing;
+// Skip the objects and lamps outside the view frustum
+extern bool gUseFrustumCulling;
+// Cull the objects in a compute shader and draw them with one indirect multi-draw call
+extern bool gUseGpuCulling;
+extern CullingStats gCullingStats;
+
+// Functions to create and destroy everything the renderer draws with (a context must be current)
+bool UCreateRenderer();
+void UDestroyRenderer();
+
+// Functions to create, compile, destroy the shader program, create and render primitives
+IndexedMesh UBuildPyramidMesh();
+void UCreateMesh(GLMesh& mesh);
+void UDestroyMesh(GLMesh& mesh);
+bool UCreateTexture(const char* filename, GLuint& textureId);
+void UDestroyTexture(GLuint textureId);
+void UWaitForTextures();
+void URender();
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+bool UCreateComputeProgram(const char* compShaderSource, GLuint& programId);
+std::string UInsertShaderLibrary(const char* shaderSource, const char* librarySource);
+void UDestroyShaderProgram(GLuint programId);
+bool UAcquireShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+bool UAcquireComputeProgram(const char* compShaderSource, GLuint& programId);
+bool UFinishShaderPrograms();
+void UResolveUniforms();
+void UOrbitLights(float deltaTime);
+void UUpdateLightBuffer();
+glm::mat4 UPyramidModel(int index, int count);
+void UPlacePyramids(int count);
+void UCreatePyramidInstances(int count);
+void UCullScene(const glm::mat4& viewProjection);
+GLuint UCullObjectsOnCpu(const Frustum& frustum);
+GLuint UCullObjectsOnGpu(const Frustum& frustum);
+void UDrawScene();
+void UDrawInstances(GLuint firstInstance, GLuint count);
+void USetLightingUniforms(const LightingUniforms& uniforms, const glm::mat4& view);
+
+// Benchmarks and validation
+void UCreateRandomLights(int count, unsigned seed);
+void UPlaceRandomLights(int count, unsigned seed);
+void ULightSweepBenchmark();
+void UDrawCallBenchmark(int pyramidCount);
+void UTextureUploadBenchmark();
+void UTextureLoadBenchmark(int count);
+void UMipmapBenchmark();
+void UMeshOptimizationBenchmark();
+void ULightOrbitBenchmark();
+void UCullingBenchmark();
+bool UValidateClusters();
+bool UCompareRenderModes();
+bool URunHeadless(const RenderTarget& target, int frameCount, const char* outputFilename);
+bool URunBenchmark(int frameCount, float timestep, const char* outputFilename);
+
+// Rendering on the CPU, without an OpenGL context
+bool URunSoftwareRenderer(int frameCount, float timestep, const char* outputFilename);
+#endif
@@ -0,0 +1,195 @@
+#ifndef SCENE_LIGHTS_H
+#define SCENE_LIGHTS_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+// The orbit kernel uses the widest instruction set the compiler targets (AVX2 with PYRAMID_NATIVE on a recent x86 CPU,
+// SSE2 on any x86-64 build, NEON on ARM) and falls back to a plain loop otherwise
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCENE_LIGHTS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCENE_LIGHTS_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCENE_LIGHTS_NEON
+#endif
+
+// One light as it is placed in the scene
+struct SceneLight
+{
+    glm::vec3 position;     // Position of light in 3Dscene
+    glm::vec3 scale;        // Scale of the lamp drawn at the light
+    glm::vec3 color;        // Color of light
+    float intensity;        // Light intensity
+    float range;            // Distance the light reaches (0 for an unbounded light)
+};
+
+// rotates count points about the y-axis by angle radians, as glm::rotate(angle, y) does: x' = x cos + z sin,
+// z' = z cos - x sin (y is unchanged)
+inline void OrbitPositionsScalar(const float* restX, const float* restZ, float* x, float* z, size_t count, float angle)
+{
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    for (size_t i = 0; i < count; i++)
+    {
+        x[i] = restX[i] * c + restZ[i] * s;
+        z[i] = restZ[i] * c - restX[i] * s;
+    }
+}
+
+// the same rotation 8 (AVX2) or 4 (SSE2, NEON) lights at a time
+inline void OrbitPositions(const float* restX, const float* restZ, float* x, float* z, size_t count, float angle)
+{
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    size_t i = 0;
+#if defined(SCENE_LIGHTS_AVX2)
+    const __m256 cosine = _mm256_set1_ps(c);
+    const __m256 sine = _mm256_set1_ps(s);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 rx = _mm256_loadu_ps(restX + i);
+        __m256 rz = _mm256_loadu_ps(restZ + i);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_mul_ps(rx, cosine), _mm256_mul_ps(rz, sine)));
+        _mm256_storeu_ps(z + i, _mm256_sub_ps(_mm256_mul_ps(rz, cosine), _mm256_mul_ps(rx, sine)));
+    }
+#elif defined(SCENE_LIGHTS_SSE2)
+    const __m128 cosine = _mm_set1_ps(c);
+    const __m128 sine = _mm_set1_ps(s);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 rx = _mm_loadu_ps(restX + i);
+        __m128 rz = _mm_loadu_ps(restZ + i);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_mul_ps(rx, cosine), _mm_mul_ps(rz, sine)));
+        _mm_storeu_ps(z + i, _mm_sub_ps(_mm_mul_ps(rz, cosine), _mm_mul_ps(rx, sine)));
+    }
+#elif defined(SCENE_LIGHTS_NEON)
+    const float32x4_t cosine = vdupq_n_f32(c);
+    const float32x4_t sine = vdupq_n_f32(s);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t rx = vld1q_f32(restX + i);
+        float32x4_t rz = vld1q_f32(restZ + i);
+        vst1q_f32(x + i, vaddq_f32(vmulq_f32(rx, cosine), vmulq_f32(rz, sine)));
+        vst1q_f32(z + i, vsubq_f32(vmulq_f32(rz, cosine), vmulq_f32(rx, sine)));
+    }
+#endif
+    OrbitPositionsScalar(restX + i, restZ + i, x + i, z + i, count - i, angle);
+}
+
+// returns the instruction set OrbitPositions was compiled for
+inline const char* OrbitSimdName()
+{
+#if defined(SCENE_LIGHTS_AVX2)
+    return "AVX2";
+#elif defined(SCENE_LIGHTS_SSE2)
+    return "SSE2";
+#elif defined(SCENE_LIGHTS_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+// The scene lights as a structure of arrays: every attribute is its own packed array, so a pass over one attribute of
+// every light streams only that attribute and a SIMD register loads 8 lights' coordinates at once. Orbiting lights are
+// not integrated frame by frame; each light keeps the position it was placed at and is rotated about the y-axis by the
+// total orbit angle, so its position is computed from time and never drifts
+class SceneLights
+{
+public:
+    SceneLights() = default;
+
+    SceneLights(std::initializer_list<SceneLight> lights)
+    {
+        for (const SceneLight& light : lights)
+            Add(light);
+    }
+
+    // adds a light where it is placed now, returns its index
+    size_t Add(const SceneLight& light)
+    {
+        // Store the position the current orbit angle rotates to the one given
+        const float c = std::cos(orbitAngle);
+        const float s = std::sin(orbitAngle);
+        restX.push_back(light.position.x * c - light.position.z * s);
+        restZ.push_back(light.position.z * c + light.position.x * s);
+        x.push_back(light.position.x);
+        y.push_back(light.position.y);
+        z.push_back(light.position.z);
+        scale.push_back(light.scale);
+        red.push_back(light.color.x);
+        green.push_back(light.color.y);
+        blue.push_back(light.color.z);
+        intensity.push_back(light.intensity);
+        range.push_back(light.range);
+        return x.size() - 1;
+    }
+
+    // removes every light
+    void Clear()
+    {
+        for (std::vector<float>* attribute : { &restX, &restZ, &x, &y, &z, &red, &green, &blue, &intensity, &range })
+            attribute->clear();
+        scale.clear();
+    }
+
+    // rotates every light further about the y-axis by angle radians
+    void Orbit(float angle)
+    {
+        orbitAngle = std::fmod(orbitAngle + angle, 6.28318531f);   // Keep the angle small so sin and cos stay precise
+        OrbitPositions(restX.data(), restZ.data(), x.data(), z.data(), x.size(), orbitAngle);
+    }
+
+    size_t Size() const
+    {
+        return x.size();
+    }
+
+    bool Empty() const
+    {
+        return x.empty();
+    }
+
+    glm::vec3 Position(size_t i) const
+    {
+        return glm::vec3(x[i], y[i], z[i]);
+    }
+
+    const glm::vec3& Scale(size_t i) const
+    {
+        return scale[i];
+    }
+
+    glm::vec3 Color(size_t i) const
+    {
+        return glm::vec3(red[i], green[i], blue[i]);
+    }
+
+    float Intensity(size_t i) const
+    {
+        return intensity[i];
+    }
+
+    float Range(size_t i) const
+    {
+        return range[i];
+    }
+
+private:
+    float orbitAngle = 0.0f;
+    std::vector<float> restX, restZ;    // Positions at orbit angle 0 (y never changes)
+    std::vector<float> x, y, z;
+    std::vector<glm::vec3> scale;       // Only read to place the lamps
+    std::vector<float> red, green, blue;
+    std::vector<float> intensity;
+    std::vector<float> range;
+};
+#endif
@@ -0,0 +1,163 @@
+#ifndef SCENE_REGISTRY_H
+#define SCENE_REGISTRY_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Refers to one object of a SceneRegistry. A handle stays valid while other objects are created and destroyed, and
+// is recognized as stale once its object is destroyed, even if the slot is reused
+struct SceneHandle
+{
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// The objects in the scene as dense component arrays: object i's model matrix, mesh and material are element i of
+// Models(), Meshes() and Materials(), with no gaps, so passes over every object stream through memory. Handles map to
+// array elements through a slot table; destroying an object moves the last one into its place and updates that
+// object's slot, so the arrays stay packed without invalidating any other handle
+class SceneRegistry
+{
+public:
+    // adds an object, returns its handle
+    SceneHandle Create(const glm::mat4& model, uint32_t mesh, uint32_t material)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = (uint32_t)slotIndices.size();
+            slotIndices.push_back(0);
+            slotGenerations.push_back(0);
+        }
+        slotIndices[slot] = (uint32_t)models.size();
+
+        models.push_back(model);
+        meshes.push_back(mesh);
+        materials.push_back(material);
+        slots.push_back(slot);
+        version++;
+        return { slot, slotGenerations[slot] };
+    }
+
+    // removes an object, returns false if the handle is stale
+    bool Destroy(SceneHandle handle)
+    {
+        if (!Valid(handle))
+            return false;
+
+        // Move the last object into the hole
+        const uint32_t index = slotIndices[handle.slot];
+        const uint32_t last = (uint32_t)models.size() - 1;
+        models[index] = models[last];
+        meshes[index] = meshes[last];
+        materials[index] = materials[last];
+        slots[index] = slots[last];
+        slotIndices[slots[index]] = index;
+        models.pop_back();
+        meshes.pop_back();
+        materials.pop_back();
+        slots.pop_back();
+
+        slotGenerations[handle.slot]++;     // Existing handles to the slot are now stale
+        freeSlots.push_back(handle.slot);
+        version++;
+        return true;
+    }
+
+    // removes every object, invalidating every handle
+    void Clear()
+    {
+        for (uint32_t slot : slots)
+        {
+            slotGenerations[slot]++;
+            freeSlots.push_back(slot);
+        }
+        models.clear();
+        meshes.clear();
+        materials.clear();
+        slots.clear();
+        version++;
+    }
+
+    // returns true if handle refers to an object that has not been destroyed
+    bool Valid(SceneHandle handle) const
+    {
+        return handle.slot < slotGenerations.size() && slotGenerations[handle.slot] == handle.generation;
+    }
+
+    // returns the position of a handle's object in the component arrays (changes when objects are destroyed), or
+    // UINT32_MAX if the handle is stale
+    uint32_t Index(SceneHandle handle) const
+    {
+        return Valid(handle) ? slotIndices[handle.slot] : UINT32_MAX;
+    }
+
+    // changes an object's model matrix, returns false if the handle is stale
+    bool SetModel(SceneHandle handle, const glm::mat4& model)
+    {
+        if (!Valid(handle))
+            return false;
+        models[slotIndices[handle.slot]] = model;
+        version++;
+        return true;
+    }
+
+    // changes an object's material, returns false if the handle is stale
+    bool SetMaterial(SceneHandle handle, uint32_t material)
+    {
+        if (!Valid(handle))
+            return false;
+        materials[slotIndices[handle.slot]] = material;
+        version++;
+        return true;
+    }
+
+    // returns the number of objects
+    size_t Size() const
+    {
+        return models.size();
+    }
+
+    const std::vector<glm::mat4>& Models() const
+    {
+        return models;
+    }
+
+    const std::vector<uint32_t>& Meshes() const
+    {
+        return meshes;
+    }
+
+    const std::vector<uint32_t>& Materials() const
+    {
+        return materials;
+    }
+
+    // returns a number that changes whenever an object is created, destroyed or modified
+    uint64_t Version() const
+    {
+        return version;
+    }
+
+private:
+    // Components, one element per object
+    std::vector<glm::mat4> models;
+    std::vector<uint32_t> meshes;
+    std::vector<uint32_t> materials;
+    std::vector<uint32_t> slots;            // Slot of each object, to fix up the slot table when objects move
+
+    // Slot table, one element per handle slot
+    std::vector<uint32_t> slotIndices;      // Position of the slot's object in the component arrays
+    std::vector<uint32_t> slotGenerations;  // Incremented when the slot's object is destroyed
+    std::vector<uint32_t> freeSlots;
+
+    uint64_t version = 0;
+};
+#endif
@@ -0,0 +1,69 @@
+#ifndef SHADER_REGISTRY_H
+#define SHADER_REGISTRY_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <unordered_map>
+
+// Shader program handles keyed by a hash of their sources, so identical programs are compiled and linked once and
+// shared by every user. The registry owns the programs; handles taken from it must not be deleted by their users
+class ShaderRegistry
+{
+public:
+    // returns a 64 bit FNV-1a hash of the shader sources of a program, in stage order (null sources are skipped)
+    static uint64_t Hash(const char* vertexSource, const char* fragmentSource, const char* computeSource = nullptr)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        const char* sources[3] = { vertexSource, fragmentSource, computeSource };
+        for (int stage = 0; stage < 3; stage++)
+        {
+            // Mix in the stage so the same string used as a different stage hashes differently
+            hash = (hash ^ static_cast<uint64_t>(stage + 1)) * 1099511628211ull;
+            for (const char* c = sources[stage]; c != nullptr && *c != '\0'; c++)
+                hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // returns the program registered for a hash (0 if there is none), counting a reuse when found
+    GLuint Find(uint64_t hash)
+    {
+        auto program = programs.find(hash);
+        if (program == programs.end())
+            return 0;
+        reuses++;
+        return program->second;
+    }
+
+    // registers a newly linked program
+    void Add(uint64_t hash, GLuint programId)
+    {
+        programs[hash] = programId;
+    }
+
+    // deletes every registered program
+    void Destroy()
+    {
+        for (const auto& program : programs)
+            glDeleteProgram(program.second);
+        programs.clear();
+    }
+
+    // returns the number of distinct programs
+    size_t Count() const
+    {
+        return programs.size();
+    }
+
+    // returns the number of requests that were served by an existing program
+    size_t Reuses() const
+    {
+        return reuses;
+    }
+
+private:
+    std::unordered_map<uint64_t, GLuint> programs;
+    size_t reuses = 0;
+};
+#endif
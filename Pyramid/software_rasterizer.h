@@ -0,0 +1,877 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "indexed_mesh.h"
+#include "mipmap.h"
+
+// Edges are evaluated for a row of pixels at once with the widest instruction set the compiler targets (8 pixels with
+// AVX2, 4 with SSE2) and one pixel at a time otherwise
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SOFTWARE_RASTER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_RASTER_SSE2
+#endif
+
+// Renders the pyramid scene on the CPU for machines without a GPU. Draws transform their instances and bin the
+// triangles into screen tiles on every core; EndFrame then gives each core whole tiles to clear, rasterize and shade,
+// so no two threads ever touch the same pixel. Triangles are clipped to the near and far planes and a guard band,
+// snapped to 1/16 pixel and covered with half-space edge functions in integers, following the OpenGL top-left rule.
+// Pixels are depth tested (GL_LESS) and shaded with a port of the lighting shader library's CalcPointLight, with the
+// texture sampled bilinearly with GL_REPEAT from a mip level chosen per triangle. The color buffer is RGBA8 with the
+// bottom row first, as glReadPixels returns it, so frames can be written with WritePPM
+
+// Phong lighting model calculations to generate ambient, diffuse, and specular components (must match CalcPointLight in
+// the lighting shader library)
+inline glm::vec3 CalcPointLight(glm::vec3 lightPos, glm::vec3 lightColor, float lightIntensity, float lightRange, glm::vec3 vertexFragmentPos, glm::vec3 vertexNormal, glm::vec3 viewPosition)
+{
+    // Calculate Ambient lighting
+    glm::vec3 ambient = lightIntensity * lightColor;
+
+    // Calculate Diffuse lighting
+    glm::vec3 norm = glm::normalize(vertexNormal);
+    glm::vec3 lightDirection = glm::normalize(lightPos - vertexFragmentPos);
+    float impact = std::max(glm::dot(norm, lightDirection), 0.2f);
+    glm::vec3 diffuse = impact * lightColor;
+
+    // Calculate Specular lighting
+    float specularIntensity = 0.0f;
+    float highlightSize = 0.0f;
+    glm::vec3 specular(0.0f);
+    if (specularIntensity > 0.0f)   // Skips two normalizes and a pow per light while the shader's strength is 0
+    {
+        glm::vec3 viewDir = glm::normalize(viewPosition - vertexFragmentPos);
+        glm::vec3 reflectDir = -lightDirection - 2.0f * glm::dot(norm, -lightDirection) * norm;    // reflect(-lightDirection, norm)
+        float specularComponent = std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), highlightSize);
+        specular = specularIntensity * specularComponent * lightColor;
+    }
+
+    // Fade lights with a range out to zero at the edge of their range
+    float attenuation = 1.0f;
+    if (lightRange > 0.0f)
+    {
+        float ratio = glm::length(lightPos - vertexFragmentPos) / lightRange;
+        attenuation = std::pow(glm::clamp(1.0f - std::pow(ratio, 4.0f), 0.0f, 1.0f), 2.0f);
+    }
+
+    // Calculate phong result
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+// A scene light as the lighting shader library reads it
+struct SoftwareLight
+{
+    glm::vec3 position;
+    glm::vec3 color;
+    float intensity;
+    float range;        // 0 for an unbounded light
+};
+
+// CPU copy of a texture and its mip chain, sampled bilinearly with GL_REPEAT. The level is chosen per triangle from
+// the ratio of its texel area to its pixel area, so minified triangles read a level whose texels stay in cache
+class SoftwareTexture
+{
+public:
+    // copies width x height RGBA8 texels, rows in the order glTexImage2D would receive them, and builds the mip chain as
+    // the texture loader does
+    void Create(const unsigned char* rgba, int width, int height)
+    {
+        levels.clear();
+        levels.push_back({ width, height, std::vector<unsigned char>(rgba, rgba + static_cast<size_t>(width) * height * 4) });
+        for (MipLevel& level : GenerateMipChain(rgba, width, height, 4, MipFilter::Kaiser, true))
+            levels.push_back(std::move(level));
+    }
+
+    // returns the level closest to one texel per pixel for a triangle covering texelArea base level texels per pixel
+    int SelectLevel(float texelArea) const
+    {
+        if (levels.empty() || !(texelArea > 1.0f))
+            return 0;
+        int level = static_cast<int>(std::lround(0.5f * std::log2(texelArea)));
+        return std::min(level, static_cast<int>(levels.size()) - 1);
+    }
+
+    // returns the bilinearly filtered color of a level at a texture coordinate, wrapping outside [0, 1]
+    glm::vec3 Sample(float u, float v, int levelIndex) const
+    {
+        if (levels.empty())
+            return glm::vec3(0.5f);     // Mid grey, as the GL placeholder
+
+        const MipLevel& level = levels[levelIndex];
+        float x = u * level.width - 0.5f;
+        float y = v * level.height - 0.5f;
+        float x0 = std::floor(x);
+        float y0 = std::floor(y);
+        float fx = x - x0;
+        float fy = y - y0;
+        int left = Wrap(static_cast<int>(x0), level.width);
+        int right = Wrap(left + 1, level.width);
+        int bottom = Wrap(static_cast<int>(y0), level.height);
+        int top = Wrap(bottom + 1, level.height);
+
+        const unsigned char* row0 = &level.pixels[static_cast<size_t>(bottom) * level.width * 4];
+        const unsigned char* row1 = &level.pixels[static_cast<size_t>(top) * level.width * 4];
+        glm::vec3 lower = Texel(row0, left) + (Texel(row0, right) - Texel(row0, left)) * fx;
+        glm::vec3 upper = Texel(row1, left) + (Texel(row1, right) - Texel(row1, left)) * fx;
+        return (lower + (upper - lower) * fy) * (1.0f / 255.0f);
+    }
+
+    int Width() const
+    {
+        return levels.empty() ? 1 : levels[0].width;
+    }
+
+    int Height() const
+    {
+        return levels.empty() ? 1 : levels[0].height;
+    }
+
+private:
+    static int Wrap(int coordinate, int size)
+    {
+        coordinate %= size;
+        return coordinate < 0 ? coordinate + size : coordinate;
+    }
+
+    static glm::vec3 Texel(const unsigned char* row, int x)
+    {
+        return glm::vec3(row[x * 4], row[x * 4 + 1], row[x * 4 + 2]);
+    }
+
+    std::vector<MipLevel> levels;   // Base level first
+};
+
+// Work done by the last frame
+struct SoftwareFrameStats
+{
+    size_t triangles = 0;   // Submitted by the draws
+    size_t rasterized = 0;  // Left after clipping and dropping degenerate and off screen triangles
+    size_t pixels = 0;      // Passed the depth test and were shaded
+};
+
+class SoftwareRasterizer
+{
+public:
+    static const int TILE_SIZE = 32;            // Pixels per side of a screen tile
+    static const int SUBPIXEL_BITS = 4;         // Vertices are snapped to 1/16 pixel
+    static const int GUARD_BAND = 128;          // Pixels past each screen edge triangles may reach before being clipped
+    static const size_t TRIANGLES_PER_JOB = 256;
+#if defined(SOFTWARE_RASTER_AVX2)
+    static const int LANES = 8;
+#elif defined(SOFTWARE_RASTER_SSE2)
+    static const int LANES = 4;
+#else
+    static const int LANES = 1;
+#endif
+
+    // allocates the color and depth buffers and starts the worker threads (one less than the number of cores, the
+    // calling thread works too). Returns false if the frame is too large for 32 bit edge functions
+    bool Create(int frameWidth, int frameHeight, unsigned threadCount = 0)
+    {
+        // An edge function inside a triangle's bounding box is at most the box's area in subpixels squared
+        const int64_t extentX = (static_cast<int64_t>(frameWidth) + 2 * GUARD_BAND + TILE_SIZE) << SUBPIXEL_BITS;
+        const int64_t extentY = (static_cast<int64_t>(frameHeight) + 2 * GUARD_BAND + TILE_SIZE) << SUBPIXEL_BITS;
+        if (frameWidth <= 0 || frameHeight <= 0 || extentX * extentY >= INT32_MAX)
+            return false;
+
+        width = frameWidth;
+        height = frameHeight;
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        stride = tilesX * TILE_SIZE;    // Whole tiles per row, so a row of lanes never reaches into another tile
+        color.assign(static_cast<size_t>(stride) * height, 0);
+        depth.assign(static_cast<size_t>(stride) * height, 1.0f);
+
+        if (threadCount == 0)
+            threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        stopping = false;
+        for (unsigned i = 1; i < threadCount; i++)
+            workers.emplace_back(&SoftwareRasterizer::WorkerLoop, this);
+        return true;
+    }
+
+    // stops the worker threads and releases the buffers
+    void Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+        color.clear();
+        depth.clear();
+        batches.clear();
+        draws.clear();
+    }
+
+    // starts a frame seen through viewProjection from viewPosition and lit by lights
+    void BeginFrame(const glm::mat4& viewProjection, glm::vec3 viewPosition, const std::vector<SoftwareLight>& lights)
+    {
+        frameViewProjection = viewProjection;
+        frameViewPosition = viewPosition;
+        frameLights = lights;
+        for (size_t i = 0; i < batchCount; i++)
+        {
+            batches[i].triangles.clear();
+            for (std::vector<uint32_t>& bin : batches[i].bins)
+                bin.clear();
+        }
+        batchCount = 0;
+        draws.clear();
+        stats = SoftwareFrameStats();
+    }
+
+    // draws the mesh once per model matrix, lit by the frame's lights and textured (mesh vertices are position, normal
+    // and texture coordinate floats)
+    void DrawLit(const IndexedMesh& mesh, const std::vector<glm::mat4>& models, const SoftwareTexture& texture, glm::vec2 uvScale)
+    {
+        Draw(mesh, models, nullptr, &texture, uvScale);
+    }
+
+    // draws the mesh once per model matrix in one flat color per instance, as the lamp shader does
+    void DrawFlat(const IndexedMesh& mesh, const std::vector<glm::mat4>& models, const std::vector<glm::vec4>& colors)
+    {
+        Draw(mesh, models, &colors, nullptr, glm::vec2(1.0f));
+    }
+
+    // clears every tile to black and rasterizes and shades the triangles binned into it
+    void EndFrame()
+    {
+        std::atomic<size_t> pixels(0);
+        ParallelFor(static_cast<size_t>(tilesX) * tilesY, [this, &pixels](size_t tile)
+        {
+            pixels += RenderTile(static_cast<int>(tile % tilesX), static_cast<int>(tile / tilesX));
+        });
+        stats.pixels = pixels;
+    }
+
+    // copies the color buffer as glReadPixels would (RGBA8, bottom row first)
+    void ReadPixels(std::vector<unsigned char>& pixels) const
+    {
+        pixels.resize(static_cast<size_t>(width) * height * 4);
+        unsigned char* out = pixels.data();
+        for (int y = 0; y < height; y++)
+        {
+            const uint32_t* row = &color[static_cast<size_t>(y) * stride];
+            for (int x = 0; x < width; x++, out += 4)
+            {
+                out[0] = static_cast<unsigned char>(row[x]);
+                out[1] = static_cast<unsigned char>(row[x] >> 8);
+                out[2] = static_cast<unsigned char>(row[x] >> 16);
+                out[3] = static_cast<unsigned char>(row[x] >> 24);
+            }
+        }
+    }
+
+    const SoftwareFrameStats& Stats() const
+    {
+        return stats;
+    }
+
+    unsigned ThreadCount() const
+    {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    static const char* SimdName()
+    {
+#if defined(SOFTWARE_RASTER_AVX2)
+        return "AVX2";
+#elif defined(SOFTWARE_RASTER_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    static const int ATTRIBUTE_COUNT = 8;   // World position, normal and texture coordinates
+    static const int MAX_CLIP_VERTICES = 9; // A triangle clipped by six planes
+
+    // A vertex in clip space with the attributes interpolated across its triangle
+    struct ClipVertex
+    {
+        glm::vec4 position;
+        float attributes[ATTRIBUTE_COUNT];
+    };
+
+    // Everything the tiles need to rasterize and shade one screen space triangle
+    struct RasterTriangle
+    {
+        int32_t edgeX[3], edgeY[3];     // Start of edge i (the edge opposite vertex i), in subpixels
+        int32_t edgeDX[3], edgeDY[3];   // Edge vector
+        int32_t edgeBias[3];            // -1 for edges the top-left rule leaves uncovered, 0 otherwise
+        int minX, minY, maxX, maxY;     // Pixel bounds, clamped to the screen
+        float invArea;
+        float depth[3];                 // Window space depth
+        float invW[3];
+        float attributes[3][ATTRIBUTE_COUNT];   // Divided by w for perspective correct interpolation
+        glm::vec4 flatColor;
+        uint32_t draw;
+        int textureLevel;
+    };
+
+    // Triangles set up by one job, binned per tile. Tiles read the batches in order so triangles are drawn in
+    // submission order, as the GPU does
+    struct Batch
+    {
+        std::vector<RasterTriangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;
+    };
+
+    struct DrawState
+    {
+        const SoftwareTexture* texture;     // nullptr for flat colored draws
+        glm::vec2 uvScale;
+    };
+
+    void Draw(const IndexedMesh& mesh, const std::vector<glm::mat4>& models, const std::vector<glm::vec4>* colors, const SoftwareTexture* texture, glm::vec2 uvScale)
+    {
+        const size_t meshTriangles = mesh.indices.size() / 3;
+        const size_t totalTriangles = meshTriangles * models.size();
+        if (totalTriangles == 0 || mesh.floatsPerVertex != ATTRIBUTE_COUNT)
+            return;
+
+        const uint32_t drawIndex = static_cast<uint32_t>(draws.size());
+        draws.push_back({ texture, uvScale });
+        stats.triangles += totalTriangles;
+
+        const size_t jobs = (totalTriangles + TRIANGLES_PER_JOB - 1) / TRIANGLES_PER_JOB;
+        const size_t firstBatch = batchCount;
+        batchCount += jobs;
+        if (batches.size() < batchCount)
+            batches.resize(batchCount);
+        for (size_t i = firstBatch; i < batchCount; i++)
+            batches[i].bins.resize(static_cast<size_t>(tilesX) * tilesY);
+
+        std::atomic<size_t> rasterized(0);
+        ParallelFor(jobs, [&, drawIndex](size_t job)
+        {
+            Batch& batch = batches[firstBatch + job];
+            std::vector<ClipVertex> transformed(mesh.VertexCount());
+            size_t currentInstance = SIZE_MAX;
+            const size_t end = std::min((job + 1) * TRIANGLES_PER_JOB, totalTriangles);
+            for (size_t triangle = job * TRIANGLES_PER_JOB; triangle < end; triangle++)
+            {
+                // Transform the vertices of an instance the first time one of its triangles is reached
+                const size_t instance = triangle / meshTriangles;
+                if (instance != currentInstance)
+                {
+                    TransformVertices(mesh, models[instance], transformed);
+                    currentInstance = instance;
+                }
+                const uint32_t* index = &mesh.indices[(triangle % meshTriangles) * 3];
+                const glm::vec4 flatColor = colors != nullptr ? (*colors)[instance] : glm::vec4(1.0f);
+                ClipAndBin(transformed[index[0]], transformed[index[1]], transformed[index[2]], flatColor, drawIndex, batch);
+            }
+            rasterized += batch.triangles.size();
+        });
+        stats.rasterized += rasterized;
+    }
+
+    // moves a mesh's vertices to clip space, with world space positions and normals as the vertex shader outputs them
+    void TransformVertices(const IndexedMesh& mesh, const glm::mat4& model, std::vector<ClipVertex>& transformed) const
+    {
+        const glm::mat4 modelViewProjection = frameViewProjection * model;
+        const glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+        for (size_t i = 0; i < transformed.size(); i++)
+        {
+            const float* vertex = &mesh.vertices[i * ATTRIBUTE_COUNT];
+            glm::vec4 position(vertex[0], vertex[1], vertex[2], 1.0f);
+            glm::vec3 world = glm::vec3(model * position);
+            glm::vec3 normal = normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]);
+
+            ClipVertex& out = transformed[i];
+            out.position = modelViewProjection * position;
+            out.attributes[0] = world.x;
+            out.attributes[1] = world.y;
+            out.attributes[2] = world.z;
+            out.attributes[3] = normal.x;
+            out.attributes[4] = normal.y;
+            out.attributes[5] = normal.z;
+            out.attributes[6] = vertex[6];
+            out.attributes[7] = vertex[7];
+        }
+    }
+
+    // clips a triangle to the near and far planes and the guard band, and sets up and bins what is left
+    void ClipAndBin(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const glm::vec4& flatColor, uint32_t drawIndex, Batch& batch) const
+    {
+        // Plane i keeps points where dot(plane, position) >= 0
+        const float guardX = 1.0f + 2.0f * GUARD_BAND / width;
+        const float guardY = 1.0f + 2.0f * GUARD_BAND / height;
+        const glm::vec4 planes[6] = {
+            glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),      // Near
+            glm::vec4(0.0f, 0.0f, -1.0f, 1.0f),     // Far
+            glm::vec4(1.0f, 0.0f, 0.0f, guardX),    // Left
+            glm::vec4(-1.0f, 0.0f, 0.0f, guardX),   // Right
+            glm::vec4(0.0f, 1.0f, 0.0f, guardY),    // Bottom
+            glm::vec4(0.0f, -1.0f, 0.0f, guardY),   // Top
+        };
+
+        // Most triangles are inside every plane or outside one of them
+        int outsideAll = 0x3F;
+        int outsideAny = 0;
+        for (const ClipVertex* vertex : { &a, &b, &c })
+        {
+            int outside = 0;
+            for (int p = 0; p < 6; p++)
+            {
+                if (glm::dot(planes[p], vertex->position) < 0.0f)
+                    outside |= 1 << p;
+            }
+            outsideAll &= outside;
+            outsideAny |= outside;
+        }
+        if (outsideAll != 0)
+            return;
+        if (outsideAny == 0)
+        {
+            SetupTriangle(a, b, c, flatColor, drawIndex, batch);
+            return;
+        }
+
+        ClipVertex polygon[MAX_CLIP_VERTICES];
+        ClipVertex clipped[MAX_CLIP_VERTICES];
+        polygon[0] = a;
+        polygon[1] = b;
+        polygon[2] = c;
+        int count = 3;
+        for (int p = 0; p < 6 && count >= 3; p++)
+        {
+            if ((outsideAny & (1 << p)) == 0)
+                continue;
+
+            int clippedCount = 0;
+            for (int i = 0; i < count; i++)
+            {
+                const ClipVertex& current = polygon[i];
+                const ClipVertex& next = polygon[(i + 1) % count];
+                float currentDistance = glm::dot(planes[p], current.position);
+                float nextDistance = glm::dot(planes[p], next.position);
+                if (currentDistance >= 0.0f)
+                    clipped[clippedCount++] = current;
+                if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+                {
+                    // Clip space is linear, so the attributes are interpolated with the position
+                    float t = currentDistance / (currentDistance - nextDistance);
+                    ClipVertex& intersection = clipped[clippedCount++];
+                    intersection.position = current.position + (next.position - current.position) * t;
+                    for (int k = 0; k < ATTRIBUTE_COUNT; k++)
+                        intersection.attributes[k] = current.attributes[k] + (next.attributes[k] - current.attributes[k]) * t;
+                }
+            }
+            std::copy(clipped, clipped + clippedCount, polygon);
+            count = clippedCount;
+        }
+
+        for (int i = 2; i < count; i++)     // The clipped polygon is convex, fan it out from its first vertex
+            SetupTriangle(polygon[0], polygon[i - 1], polygon[i], flatColor, drawIndex, batch);
+    }
+
+    // projects a clipped triangle to the screen, computes its edge functions and adds it to the bins of the tiles its
+    // bounds overlap
+    void SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const glm::vec4& flatColor, uint32_t drawIndex, Batch& batch) const
+    {
+        const ClipVertex* vertices[3] = { &a, &b, &c };
+        int32_t x[3], y[3];
+        float z[3], invW[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4& position = vertices[i]->position;
+            invW[i] = 1.0f / position.w;
+            x[i] = static_cast<int32_t>(std::lround((position.x * invW[i] * 0.5f + 0.5f) * width * (1 << SUBPIXEL_BITS)));
+            y[i] = static_cast<int32_t>(std::lround((position.y * invW[i] * 0.5f + 0.5f) * height * (1 << SUBPIXEL_BITS)));
+            z[i] = position.z * invW[i] * 0.5f + 0.5f;
+        }
+
+        // Rasterize counter-clockwise (y up); both windings are drawn since the GL renderer does not cull faces
+        int64_t area = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+        if (area == 0)
+            return;
+        int order[3] = { 0, 1, 2 };
+        if (area < 0)
+        {
+            std::swap(order[1], order[2]);
+            area = -area;
+        }
+
+        RasterTriangle triangle;
+        const int subpixel = 1 << SUBPIXEL_BITS;
+        int32_t minX = INT32_MAX, minY = INT32_MAX, maxX = INT32_MIN, maxY = INT32_MIN;
+        for (int i = 0; i < 3; i++)
+        {
+            const int v = order[i];
+            minX = std::min(minX, x[v]);
+            minY = std::min(minY, y[v]);
+            maxX = std::max(maxX, x[v]);
+            maxY = std::max(maxY, y[v]);
+            triangle.depth[i] = z[v];
+            triangle.invW[i] = invW[v];
+            for (int k = 0; k < ATTRIBUTE_COUNT; k++)
+                triangle.attributes[i][k] = vertices[v]->attributes[k] * invW[v];
+
+            // Edge i runs from vertex i + 1 to vertex i + 2
+            const int from = order[(i + 1) % 3];
+            const int to = order[(i + 2) % 3];
+            triangle.edgeX[i] = x[from];
+            triangle.edgeY[i] = y[from];
+            triangle.edgeDX[i] = x[to] - x[from];
+            triangle.edgeDY[i] = y[to] - y[from];
+            const bool topLeft = triangle.edgeDY[i] < 0 || (triangle.edgeDY[i] == 0 && triangle.edgeDX[i] < 0);
+            triangle.edgeBias[i] = topLeft ? 0 : -1;
+        }
+
+        // Pixels whose centers lie within the snapped bounds
+        triangle.minX = std::max(static_cast<int>((minX - subpixel / 2 + subpixel - 1) >> SUBPIXEL_BITS), 0);
+        triangle.minY = std::max(static_cast<int>((minY - subpixel / 2 + subpixel - 1) >> SUBPIXEL_BITS), 0);
+        triangle.maxX = std::min(static_cast<int>((maxX - subpixel / 2) >> SUBPIXEL_BITS), width - 1);
+        triangle.maxY = std::min(static_cast<int>((maxY - subpixel / 2) >> SUBPIXEL_BITS), height - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        triangle.invArea = 1.0f / static_cast<float>(area);
+        triangle.flatColor = flatColor;
+        triangle.draw = drawIndex;
+        triangle.textureLevel = 0;
+        const DrawState& draw = draws[drawIndex];
+        if (draw.texture != nullptr)
+        {
+            // Base level texels covered per pixel
+            const float* uv0 = &a.attributes[6];
+            const float* uv1 = &b.attributes[6];
+            const float* uv2 = &c.attributes[6];
+            float uvArea = std::abs((uv1[0] - uv0[0]) * (uv2[1] - uv0[1]) - (uv1[1] - uv0[1]) * (uv2[0] - uv0[0]));
+            float texelArea = uvArea * draw.uvScale.x * draw.uvScale.y * draw.texture->Width() * draw.texture->Height();
+            triangle.textureLevel = draw.texture->SelectLevel(texelArea * (subpixel * subpixel) / static_cast<float>(area));
+        }
+
+        const uint32_t index = static_cast<uint32_t>(batch.triangles.size());
+        batch.triangles.push_back(triangle);
+        for (int tileY = triangle.minY / TILE_SIZE; tileY <= triangle.maxY / TILE_SIZE; tileY++)
+        {
+            for (int tileX = triangle.minX / TILE_SIZE; tileX <= triangle.maxX / TILE_SIZE; tileX++)
+                batch.bins[static_cast<size_t>(tileY) * tilesX + tileX].push_back(index);
+        }
+    }
+
+    // clears a tile and draws every triangle binned into it, returns the number of pixels shaded
+    size_t RenderTile(int tileX, int tileY)
+    {
+        const int x0 = tileX * TILE_SIZE;
+        const int y0 = tileY * TILE_SIZE;
+        const int x1 = std::min(x0 + TILE_SIZE, width) - 1;
+        const int y1 = std::min(y0 + TILE_SIZE, height) - 1;
+        for (int y = y0; y <= y1; y++)
+        {
+            const size_t row = static_cast<size_t>(y) * stride;
+            std::fill(color.begin() + row + x0, color.begin() + row + x1 + 1, 0xFF000000u);  // Opaque black
+            std::fill(depth.begin() + row + x0, depth.begin() + row + x1 + 1, 1.0f);
+        }
+
+        size_t pixels = 0;
+        const size_t bin = static_cast<size_t>(tileY) * tilesX + tileX;
+        for (size_t i = 0; i < batchCount; i++)
+        {
+            for (uint32_t index : batches[i].bins[bin])
+                pixels += RasterizeTriangle(batches[i].triangles[index], x0, y0, x1, y1);
+        }
+        return pixels;
+    }
+
+    // covers the part of a triangle inside a tile LANES pixels at a time, starting each row at a multiple of LANES so the
+    // lanes stay inside the tile. Returns the number of pixels shaded
+    size_t RasterizeTriangle(const RasterTriangle& triangle, int tileX0, int tileY0, int tileX1, int tileY1)
+    {
+        const int minX = std::max(triangle.minX, tileX0);
+        const int minY = std::max(triangle.minY, tileY0);
+        const int maxX = std::min(triangle.maxX, tileX1);
+        const int maxY = std::min(triangle.maxY, tileY1);
+        const int startX = minX - minX % LANES;
+        const int subpixel = 1 << SUBPIXEL_BITS;
+
+        // Edge functions step by -dy per subpixel to the right, so by -dy * 16 per pixel
+        int32_t stepX[3];
+        for (int i = 0; i < 3; i++)
+            stepX[i] = -triangle.edgeDY[i] * subpixel;
+        const float depthDelta1 = (triangle.depth[1] - triangle.depth[0]) * triangle.invArea;
+        const float depthDelta2 = (triangle.depth[2] - triangle.depth[0]) * triangle.invArea;
+
+#if defined(SOFTWARE_RASTER_AVX2)
+        const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i laneStep[3], groupStep[3];
+        for (int i = 0; i < 3; i++)
+        {
+            laneStep[i] = _mm256_mullo_epi32(_mm256_set1_epi32(stepX[i]), laneIndex);
+            groupStep[i] = _mm256_set1_epi32(stepX[i] * LANES);
+        }
+        const __m256 depth0 = _mm256_set1_ps(triangle.depth[0]);
+        const __m256 depthStep1 = _mm256_set1_ps(depthDelta1);
+        const __m256 depthStep2 = _mm256_set1_ps(depthDelta2);
+#elif defined(SOFTWARE_RASTER_SSE2)
+        __m128i laneStep[3], groupStep[3];
+        for (int i = 0; i < 3; i++)
+        {
+            laneStep[i] = _mm_setr_epi32(0, stepX[i], stepX[i] * 2, stepX[i] * 3);
+            groupStep[i] = _mm_set1_epi32(stepX[i] * LANES);
+        }
+        const __m128 depth0 = _mm_set1_ps(triangle.depth[0]);
+        const __m128 depthStep1 = _mm_set1_ps(depthDelta1);
+        const __m128 depthStep2 = _mm_set1_ps(depthDelta2);
+#endif
+
+        size_t shaded = 0;
+        alignas(32) int32_t edge1[LANES], edge2[LANES];
+        alignas(32) float fragmentDepth[LANES];
+        for (int y = minY; y <= maxY; y++)
+        {
+            // Edge functions at the center of the first pixel of the row (at most LANES - 1 pixels outside the bounds, so
+            // they fit in 32 bits)
+            const int64_t sampleX = (static_cast<int64_t>(startX) << SUBPIXEL_BITS) + subpixel / 2;
+            const int64_t sampleY = (static_cast<int64_t>(y) << SUBPIXEL_BITS) + subpixel / 2;
+            int32_t rowEdge[3];
+            for (int i = 0; i < 3; i++)
+            {
+                rowEdge[i] = static_cast<int32_t>(static_cast<int64_t>(triangle.edgeDX[i]) * (sampleY - triangle.edgeY[i])
+                    - static_cast<int64_t>(triangle.edgeDY[i]) * (sampleX - triangle.edgeX[i]) + triangle.edgeBias[i]);
+            }
+
+            float* depthRow = &depth[static_cast<size_t>(y) * stride];
+#if defined(SOFTWARE_RASTER_AVX2)
+            __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(rowEdge[0]), laneStep[0]);
+            __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(rowEdge[1]), laneStep[1]);
+            __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(rowEdge[2]), laneStep[2]);
+            for (int x = startX; x <= maxX; x += LANES)
+            {
+                // A pixel is covered when no edge function is negative
+                int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_or_si256(e0, e1), e2))) & LaneMask(x, minX, maxX);
+                if (mask != 0)
+                {
+                    __m256 z = _mm256_add_ps(depth0, _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(e1), depthStep1), _mm256_mul_ps(_mm256_cvtepi32_ps(e2), depthStep2)));
+                    mask &= _mm256_movemask_ps(_mm256_cmp_ps(z, _mm256_loadu_ps(depthRow + x), _CMP_LT_OQ));
+                    if (mask != 0)
+                    {
+                        _mm256_store_si256(reinterpret_cast<__m256i*>(edge1), e1);
+                        _mm256_store_si256(reinterpret_cast<__m256i*>(edge2), e2);
+                        _mm256_store_ps(fragmentDepth, z);
+                        shaded += ShadeMask(triangle, mask, x, y, edge1, edge2, fragmentDepth);
+                    }
+                }
+                e0 = _mm256_add_epi32(e0, groupStep[0]);
+                e1 = _mm256_add_epi32(e1, groupStep[1]);
+                e2 = _mm256_add_epi32(e2, groupStep[2]);
+            }
+#elif defined(SOFTWARE_RASTER_SSE2)
+            __m128i e0 = _mm_add_epi32(_mm_set1_epi32(rowEdge[0]), laneStep[0]);
+            __m128i e1 = _mm_add_epi32(_mm_set1_epi32(rowEdge[1]), laneStep[1]);
+            __m128i e2 = _mm_add_epi32(_mm_set1_epi32(rowEdge[2]), laneStep[2]);
+            for (int x = startX; x <= maxX; x += LANES)
+            {
+                int mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(_mm_or_si128(e0, e1), e2))) & LaneMask(x, minX, maxX);
+                if (mask != 0)
+                {
+                    __m128 z = _mm_add_ps(depth0, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(e1), depthStep1), _mm_mul_ps(_mm_cvtepi32_ps(e2), depthStep2)));
+                    mask &= _mm_movemask_ps(_mm_cmplt_ps(z, _mm_loadu_ps(depthRow + x)));
+                    if (mask != 0)
+                    {
+                        _mm_store_si128(reinterpret_cast<__m128i*>(edge1), e1);
+                        _mm_store_si128(reinterpret_cast<__m128i*>(edge2), e2);
+                        _mm_store_ps(fragmentDepth, z);
+                        shaded += ShadeMask(triangle, mask, x, y, edge1, edge2, fragmentDepth);
+                    }
+                }
+                e0 = _mm_add_epi32(e0, groupStep[0]);
+                e1 = _mm_add_epi32(e1, groupStep[1]);
+                e2 = _mm_add_epi32(e2, groupStep[2]);
+            }
+#else
+            int32_t e0 = rowEdge[0], e1 = rowEdge[1], e2 = rowEdge[2];
+            for (int x = minX; x <= maxX; x++)
+            {
+                if ((e0 | e1 | e2) >= 0)
+                {
+                    float z = triangle.depth[0] + (e1 * depthDelta1 + e2 * depthDelta2);
+                    if (z < depthRow[x])
+                    {
+                        edge1[0] = e1;
+                        edge2[0] = e2;
+                        fragmentDepth[0] = z;
+                        shaded += ShadeMask(triangle, 1, x, y, edge1, edge2, fragmentDepth);
+                    }
+                }
+                e0 += stepX[0];
+                e1 += stepX[1];
+                e2 += stepX[2];
+            }
+#endif
+        }
+        return shaded;
+    }
+
+    // returns a bit per lane of the group starting at x that lies within [minX, maxX]
+    static int LaneMask(int x, int minX, int maxX)
+    {
+        int mask = (1 << LANES) - 1;
+        if (x < minX)
+            mask &= ~((1 << (minX - x)) - 1);
+        if (maxX - x + 1 < LANES)
+            mask &= (1 << (maxX - x + 1)) - 1;
+        return mask;
+    }
+
+    // writes the depth and shaded color of the pixels in mask, starting at x, returns the number of pixels written
+    int ShadeMask(const RasterTriangle& triangle, int mask, int x, int y, const int32_t* edge1, const int32_t* edge2, const float* fragmentDepth)
+    {
+        const DrawState& draw = draws[triangle.draw];
+        const size_t row = static_cast<size_t>(y) * stride;
+        int count = 0;
+        for (; mask != 0; mask &= mask - 1)
+        {
+            int lane = 0;
+            while ((mask & (1 << lane)) == 0)
+                lane++;
+            const size_t pixel = row + x + lane;
+            depth[pixel] = fragmentDepth[lane];
+            count++;
+
+            glm::vec4 result = triangle.flatColor;
+            if (draw.texture != nullptr)
+            {
+                // Perspective correct interpolation of the vertex shader outputs
+                const float lambda1 = edge1[lane] * triangle.invArea;
+                const float lambda2 = edge2[lane] * triangle.invArea;
+                const float lambda0 = 1.0f - lambda1 - lambda2;
+                const float w = 1.0f / (lambda0 * triangle.invW[0] + lambda1 * triangle.invW[1] + lambda2 * triangle.invW[2]);
+                float attributes[ATTRIBUTE_COUNT];
+                for (int k = 0; k < ATTRIBUTE_COUNT; k++)
+                    attributes[k] = (lambda0 * triangle.attributes[0][k] + lambda1 * triangle.attributes[1][k] + lambda2 * triangle.attributes[2][k]) * w;
+
+                const glm::vec3 fragmentPos(attributes[0], attributes[1], attributes[2]);
+                const glm::vec3 fragmentNormal(attributes[3], attributes[4], attributes[5]);
+                const glm::vec3 textureColor = draw.texture->Sample(attributes[6] * draw.uvScale.x, attributes[7] * draw.uvScale.y, triangle.textureLevel);
+                glm::vec3 lit(0.0f);
+                for (const SoftwareLight& light : frameLights)
+                    lit += CalcPointLight(light.position, light.color, light.intensity, light.range, fragmentPos, fragmentNormal, frameViewPosition) * textureColor;
+                result = glm::vec4(lit, 1.0f);
+            }
+            color[pixel] = PackColor(result);
+        }
+        return count;
+    }
+
+    // converts a color to RGBA8 as a UNORM framebuffer does
+    static uint32_t PackColor(const glm::vec4& value)
+    {
+        uint32_t packed = 0;
+        for (int c = 0; c < 4; c++)
+            packed |= static_cast<uint32_t>(std::lround(glm::clamp(value[c], 0.0f, 1.0f) * 255.0f)) << (c * 8);
+        return packed;
+    }
+
+    // runs job(i) for every i in [0, count) on the workers and the calling thread, returns when all have finished
+    void ParallelFor(size_t count, const std::function<void(size_t)>& job)
+    {
+        if (count == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentJob = &job;
+            jobCount = count;
+            nextItem = 0;
+            remainingItems = count;
+            acknowledgedWorkers = 0;
+            generation++;
+        }
+        jobAvailable.notify_all();
+        RunItems();
+
+        // Wait for the last item, and for every worker to have taken this job and left RunItems. A worker that had not
+        // woken yet would otherwise take this job after it returned and race the next one for nextItem
+        std::unique_lock<std::mutex> lock(mutex);
+        jobFinished.wait(lock, [this] { return remainingItems == 0 && acknowledgedWorkers == workers.size() && activeWorkers == 0; });
+    }
+
+    void RunItems()
+    {
+        for (size_t item = nextItem++; item < jobCount; item = nextItem++)
+        {
+            (*currentJob)(item);
+            if (--remainingItems == 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobFinished.notify_all();
+            }
+        }
+    }
+
+    void WorkerLoop()
+    {
+        uint64_t seenGeneration = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping)
+                    return;
+                seenGeneration = generation;
+                acknowledgedWorkers++;
+                activeWorkers++;
+            }
+            RunItems();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                activeWorkers--;
+            }
+            jobFinished.notify_all();
+        }
+    }
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    int stride = 0;                 // Pixels per buffer row
+    std::vector<uint32_t> color;    // RGBA8, bottom row first
+    std::vector<float> depth;
+
+    // Current frame
+    glm::mat4 frameViewProjection;
+    glm::vec3 frameViewPosition;
+    std::vector<SoftwareLight> frameLights;
+    std::vector<DrawState> draws;
+    std::vector<Batch> batches;     // Kept between frames so the bins keep their capacity
+    size_t batchCount = 0;
+    SoftwareFrameStats stats;
+
+    // Worker threads
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobFinished;
+    bool stopping = false;
+    uint64_t generation = 0;
+    unsigned activeWorkers = 0;
+    size_t acknowledgedWorkers = 0;     // Workers that have taken the current job
+    const std::function<void(size_t)>* currentJob = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextItem{ 0 };
+    std::atomic<size_t> remainingItems{ 0 };
+};
+#endif
@@ -0,0 +1,327 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stb_image.h"
+#include "ktx2.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+#include "pixel_upload_ring.h"
+
+// Loads textures without blocking the GL thread. Request creates the texture straight away with a placeholder texel and
+// queues the image for a pool of worker threads to decode; Update, called on the GL thread once per frame, streams every
+// decoded image into its texture through a ring of persistently mapped pixel unpack buffer segments. The texture handle
+// never changes, so callers can bind it before the image has arrived. KTX2 files cooked by texture_cooker are read as
+// they are and their block compressed mip levels uploaded with glCompressedTexImage2D instead. Files are memory mapped:
+// stb_image decodes straight from the mapping and compressed levels are copied from it into the upload ring, so no read
+// buffer or copy of the file is ever allocated. The workers also build the mip chains of decoded images (Kaiser filtered,
+// averaged as linear light since the textures are sRGB photos) so the GL thread never runs glGenerateMipmap
+class TextureLoader
+{
+public:
+    static const size_t UPLOAD_SEGMENT_SIZE = 4 * 1024 * 1024;    // Bytes per upload ring segment
+
+    // starts the worker threads (one less than the number of cores, at least one) and creates the upload ring. Without
+    // mapAssets files are read with stdio as they were before mapping
+    void Create(unsigned threadCount = 0, bool mapAssets = true)
+    {
+        mapFiles = mapAssets;
+        if (!ring.Create(UPLOAD_SEGMENT_SIZE))
+            std::cout << "Failed to map texture upload ring, uploading from client memory" << std::endl;
+
+        if (threadCount == 0)
+        {
+            unsigned cores = std::thread::hardware_concurrency();
+            threadCount = cores > 1 ? cores - 1 : 1;
+        }
+        stopping = false;
+        for (unsigned i = 0; i < threadCount; i++)
+            workers.emplace_back(&TextureLoader::WorkerLoop, this);
+    }
+
+    // stops the worker threads and releases the upload ring and any decoded image that was never uploaded
+    void Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            jobs.clear();
+        }
+        jobAvailable.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+
+        for (DecodedImage& image : decoded)
+            stbi_image_free(image.pixels);      // Mapped files are closed with the deque
+        decoded.clear();
+        pending = 0;
+
+        ring.Destroy();
+    }
+
+    // creates a texture showing the placeholder and queues the image file to be decoded into it, returns false if the
+    // file does not exist
+    bool Request(const char* filename, GLuint& textureId)
+    {
+        if (!std::filesystem::exists(filename))
+            return false;
+
+        glGenTextures(1, &textureId);               // Create texture ID
+        glBindTexture(GL_TEXTURE_2D, textureId);    // Bind texure
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);       // Specify how to wrap texture
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);   // Until Upload adds the mips
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        const unsigned char placeholder[4] = { 128, 128, 128, 255 };       // Mid grey until the image is ready
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back({ textureId, filename });
+            pending++;
+        }
+        jobAvailable.notify_one();
+        return true;
+    }
+
+    // uploads every image the workers have finished decoding (GL thread only), returns the number uploaded
+    int Update()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty())
+                return 0;
+            ready.swap(decoded);
+        }
+
+        int uploaded = 0;
+        for (DecodedImage& image : ready)
+        {
+            if (image.pixels == nullptr && image.compressed.levels.empty())
+                std::cout << "Failed to load texture " << image.filename << std::endl;
+            else if (image.pixels == nullptr ? UploadCompressed(image) : Upload(image))
+                uploaded++;
+            stbi_image_free(image.pixels);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        ready.clear();
+        return uploaded;
+    }
+
+    // blocks until every requested texture has been decoded and uploaded
+    void Finish()
+    {
+        while (Pending() > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                imageDecoded.wait(lock, [this] { return !decoded.empty(); });
+            }
+            Update();
+        }
+    }
+
+    // returns the OpenGL internal format of a KTX2 format, or 0 if it is unknown or the driver cannot sample it
+    static GLenum CompressedFormat(uint32_t vkFormat)
+    {
+        switch (vkFormat)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            return GLEW_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : 0;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;              // Core since OpenGL 4.2
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility ? GL_COMPRESSED_RGB8_ETC2 : 0;
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility ? GL_COMPRESSED_SRGB8_ETC2 : 0;
+        default:
+            return 0;
+        }
+    }
+
+    // returns the number of requested textures that have not been uploaded yet
+    size_t Pending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+private:
+    struct Job
+    {
+        GLuint textureId;
+        std::string filename;
+    };
+
+    struct DecodedImage
+    {
+        GLuint textureId;
+        std::string filename;
+        unsigned char* pixels;  // Allocated by stb_image, nullptr if decoding failed or the image is compressed
+        int width;
+        int height;
+        int channels;
+        std::vector<MipLevel> mips;     // Levels below the decoded image, built by the worker
+        KTX2Image compressed;   // Levels of a KTX2 file, empty for other images
+        MappedFile file;        // Holds the compressed levels until they are uploaded
+    };
+
+    // decodes queued images until the loader is destroyed
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+
+            DecodedImage image = { job.textureId, job.filename, nullptr, 0, 0, 0 };
+            std::string error;
+            bool compressed = std::filesystem::path(job.filename).extension() == ".ktx2";
+            if (!mapFiles)
+            {
+                if (compressed)
+                    ReadKTX2(job.filename, image.compressed, error);
+                else
+                    image.pixels = stbi_load(job.filename.c_str(), &image.width, &image.height, &image.channels, 0);
+            }
+            else if (!image.file.Open(job.filename))
+                error = "cannot map file";
+            else if (compressed)
+                ParseKTX2(image.file.Data(), image.file.Size(), image.compressed, error);
+            else
+            {
+                image.pixels = stbi_load_from_memory(image.file.Data(), static_cast<int>(image.file.Size()), &image.width, &image.height, &image.channels, 0);
+                image.file.Close();     // Only the decoded pixels are uploaded
+            }
+            if (!error.empty())
+                std::cout << "Failed to read " << job.filename << ": " << error << std::endl;
+
+            if (image.pixels != nullptr && image.channels != 3 && image.channels != 4)
+            {
+                std::cout << "Not implemented to handle image with " << image.channels << " channels" << std::endl;
+                stbi_image_free(image.pixels);
+                image.pixels = nullptr;
+            }
+            if (image.pixels != nullptr)
+                image.mips = GenerateMipChain(image.pixels, image.width, image.height, image.channels, MipFilter::Kaiser, true);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decoded.push_back(std::move(image));
+            }
+            imageDecoded.notify_all();
+        }
+    }
+
+    // streams a decoded image into its texture
+    bool Upload(const DecodedImage& image)
+    {
+        glBindTexture(GL_TEXTURE_2D, image.textureId);
+        UploadLevel(image.pixels, image.width, image.height, image.channels, 0);
+        for (size_t level = 0; level < image.mips.size(); level++)
+        {
+            const MipLevel& mip = image.mips[level];
+            UploadLevel(mip.pixels.data(), mip.width, mip.height, image.channels, static_cast<GLint>(level) + 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.mips.size()));
+        SetMinFilter(image.mips.size() + 1);
+        glBindTexture(GL_TEXTURE_2D, 0);    // Unbind the texture
+        return true;
+    }
+
+    // creates one level of the bound texture and streams its texels in
+    void UploadLevel(const unsigned char* pixels, int width, int height, int channels, GLint level)
+    {
+        GLenum internalFormat = channels == 3 ? GL_RGB8 : GL_RGBA8;
+        GLenum format = channels == 3 ? GL_RGB : GL_RGBA;
+
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        if (ring.SegmentSize() == 0 || !UploadThroughRing(ring, pixels, width, height, format, channels, level))
+        {
+            // Without a ring (or for rows wider than a segment) upload straight from the decoded image
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+    }
+
+    // uploads every mip level of a compressed image into its texture, through the ring when a level fits in a segment
+    bool UploadCompressed(const DecodedImage& image)
+    {
+        const KTX2Image& compressed = image.compressed;
+        GLenum internalFormat = CompressedFormat(compressed.vkFormat);
+        if (internalFormat == 0)
+        {
+            std::cout << "Texture format " << compressed.vkFormat << " of " << image.filename << " is not supported by the driver" << std::endl;
+            return false;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, image.textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(compressed.levels.size()) - 1);
+        for (size_t level = 0; level < compressed.levels.size(); level++)
+        {
+            const KTX2Level& mip = compressed.levels[level];
+            const unsigned char* data = compressed.data + mip.offset;
+            if (mip.size <= ring.SegmentSize())
+            {
+                unsigned char* destination = ring.Begin();
+                std::copy(data, data + mip.size, destination);
+                glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, mip.width, mip.height, 0, static_cast<GLsizei>(mip.size), (void*)ring.Offset());
+                ring.End();
+            }
+            else
+                glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, mip.width, mip.height, 0, static_cast<GLsizei>(mip.size), data);
+        }
+        SetMinFilter(compressed.levels.size());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return true;
+    }
+
+    // samples the bound texture trilinearly once levelCount levels have been uploaded, bilinearly from a lone level
+    static void SetMinFilter(size_t levelCount)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;                           // Guards jobs, decoded, pending and stopping
+    std::condition_variable jobAvailable;
+    std::condition_variable imageDecoded;
+    std::deque<Job> jobs;
+    std::deque<DecodedImage> decoded;
+    std::deque<DecodedImage> ready;             // Swapped with decoded by Update, kept so frames do not allocate
+    size_t pending = 0;
+    bool stopping = false;
+    bool mapFiles = true;                       // Set before the workers start
+
+    PixelUploadRing ring;                       // GL thread only
+};
+#endif
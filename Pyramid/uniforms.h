@@ -0,0 +1,98 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <string>
+#include <unordered_map>
+
+// Caches the locations of every active uniform in a linked shader program. The program is reflected once after
+// linking, so the render loop can upload values through the typed setters without looking up names each frame
+class ShaderUniforms
+{
+public:
+    // reflects the active uniforms of a linked shader program (call once after linking)
+    void Reflect(GLuint programId)
+    {
+        program = programId;
+        locations.clear();
+
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+        std::string name(maxNameLength, '\0');
+        for (GLint i = 0; i < uniformCount; i++)
+        {
+            GLsizei nameLength = 0;
+            GLint arraySize = 0;
+            GLenum type = 0;
+            glGetActiveUniform(programId, i, maxNameLength, &nameLength, &arraySize, &type, &name[0]);
+
+            // Uniform block members have no location and are set through their buffer instead
+            std::string uniformName = name.substr(0, nameLength);
+            GLint location = glGetUniformLocation(programId, uniformName.c_str());
+            if (location < 0)
+                continue;
+
+            // Arrays are reported as "name[0]", register the bare name and every element
+            size_t bracket = uniformName.find('[');
+            if (bracket != std::string::npos)
+            {
+                std::string baseName = uniformName.substr(0, bracket);
+                locations[baseName] = location;
+                for (GLint element = 1; element < arraySize; element++)
+                {
+                    std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                    locations[elementName] = glGetUniformLocation(programId, elementName.c_str());
+                }
+                uniformName = baseName + "[0]";
+            }
+            locations[uniformName] = location;
+        }
+    }
+
+    // returns the cached location of a uniform, or -1 if the program does not use it (call at load time, not per frame)
+    GLint Location(const std::string& uniformName) const
+    {
+        auto found = locations.find(uniformName);
+        return found == locations.end() ? -1 : found->second;
+    }
+
+    // returns the program the cache was reflected from
+    GLuint Program() const
+    {
+        return program;
+    }
+
+    // typed setters for the currently bound program (a location of -1 is silently ignored by OpenGL)
+    static void Set(GLint location, int value)
+    {
+        glUniform1i(location, value);
+    }
+    static void Set(GLint location, float value)
+    {
+        glUniform1f(location, value);
+    }
+    static void Set(GLint location, const glm::vec2& value)
+    {
+        glUniform2fv(location, 1, glm::value_ptr(value));
+    }
+    static void Set(GLint location, const glm::vec3& value)
+    {
+        glUniform3fv(location, 1, glm::value_ptr(value));
+    }
+    static void Set(GLint location, const glm::mat4& value)
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+private:
+    GLuint program = 0;
+    std::unordered_map<std::string, GLint> locations;
+};
+#endif
@@ -0,0 +1,209 @@
+/*
+
+texture_cooker compresses a texture offline so the renderer does not decode and mipmap it at startup. The image is
+decoded with stb_image, its mip chain is built with the Kaiser filter of mipmap.h, and every level is compressed to BC1 and written
+to a KTX2 file, which the texture loader uploads as it is with glCompressedTexImage2D. BC1 stores a 4x4 block of RGB
+texels in 8 bytes, a sixth of RGB8, and the GPU samples it without decompressing it in memory.
+
+Usage:
+texture_cooker INPUT OUTPUT.ktx2 [--srgb]
+
+--srgb                  Mark the texture as sRGB encoded so it is sampled as GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+
+*/
+
+#include <iostream>         // Allow for input/output
+#include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // Command line parsing
+#include <cstdint>          // Block encoding
+#include <cmath>            // Principal axis
+#include <algorithm>        // min, max
+#include <chrono>           // Cook timing
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"      // Image loading Utility functions
+#include "ktx2.h"           // Texture container
+#include "mipmap.h"         // Mip chain generation
+
+using namespace std;
+
+namespace
+{
+    uint16_t Pack565(const float color[3])
+    {
+        int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void Unpack565(uint16_t packed, int color[3])
+    {
+        int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // compresses 16 RGB texels to a BC1 block. The endpoints are the texels furthest apart along the principal axis of
+    // the block's colors, and each texel takes the closest of the four colors they define
+    void EncodeBlock(const unsigned char texels[16][3], unsigned char block[8])
+    {
+        float mean[3] = {};
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += texels[i][c] / 16.0f;
+
+        float covariance[6] = {};   // rr, rg, rb, gg, gb, bb
+        for (int i = 0; i < 16; i++)
+        {
+            float r = texels[i][0] - mean[0], g = texels[i][1] - mean[1], b = texels[i][2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+
+        // A few power iterations find the principal axis well enough for 16 points
+        float axis[3] = { 0.577f, 0.577f, 0.577f };
+        for (int iteration = 0; iteration < 4; iteration++)
+        {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float length = max(max(fabsf(x), fabsf(y)), fabsf(z));
+            if (length < 1e-6f)
+                break;              // Flat block, any axis will do
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        int lowest = 0, highest = 0;
+        float minProjection = 1e30f, maxProjection = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+            if (projection < minProjection) { minProjection = projection; lowest = i; }
+            if (projection > maxProjection) { maxProjection = projection; highest = i; }
+        }
+        const float high[3] = { (float)texels[highest][0], (float)texels[highest][1], (float)texels[highest][2] };
+        const float low[3] = { (float)texels[lowest][0], (float)texels[lowest][1], (float)texels[lowest][2] };
+        uint16_t color0 = Pack565(high), color1 = Pack565(low);
+
+        // color0 > color1 selects the four color mode; equal endpoints leave every index at 0
+        if (color0 < color1)
+            swap(color0, color1);
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            Unpack565(color0, palette[0]);
+            Unpack565(color1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = INT32_MAX;
+                for (int p = 0; p < 4; p++)
+                {
+                    int r = texels[i][0] - palette[p][0], g = texels[i][1] - palette[p][1], b = texels[i][2] - palette[p][2];
+                    int distance = r * r + g * g + b * b;
+                    if (distance < bestDistance) { bestDistance = distance; best = p; }
+                }
+                indices |= static_cast<uint32_t>(best) << (i * 2);
+            }
+        }
+
+        block[0] = color0 & 0xFF; block[1] = color0 >> 8;
+        block[2] = color1 & 0xFF; block[3] = color1 >> 8;
+        for (int i = 0; i < 4; i++)
+            block[4 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+
+    // compresses an image to BC1, repeating the edge texels to fill the blocks of sizes that are not a multiple of 4
+    vector<unsigned char> EncodeBC1(const MipLevel& image)
+    {
+        const int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+        vector<unsigned char> blocks(static_cast<size_t>(blocksX) * blocksY * 8);
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                unsigned char texels[16][3];
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = min(bx * 4 + i % 4, image.width - 1), y = min(by * 4 + i / 4, image.height - 1);
+                    for (int c = 0; c < 3; c++)
+                        texels[i][c] = image.pixels[(static_cast<size_t>(y) * image.width + x) * 4 + c];
+                }
+                EncodeBlock(texels, &blocks[(static_cast<size_t>(by) * blocksX + bx) * 8]);
+            }
+        }
+        return blocks;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* inputFilename = nullptr;
+    const char* outputFilename = nullptr;
+    uint32_t vkFormat = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--srgb") == 0)
+            vkFormat = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        else if (inputFilename == nullptr)
+            inputFilename = argv[i];
+        else if (outputFilename == nullptr)
+            outputFilename = argv[i];
+        else
+        {
+            cout << "Unknown option " << argv[i] << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (outputFilename == nullptr)
+    {
+        cout << "Usage: texture_cooker INPUT OUTPUT.ktx2 [--srgb]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start = chrono::steady_clock::now();
+    MipLevel image = {};
+    int channels = 0;
+    unsigned char* pixels = stbi_load(inputFilename, &image.width, &image.height, &channels, 4);
+    if (pixels == nullptr)
+    {
+        cout << "Failed to load " << inputFilename << endl;
+        return EXIT_FAILURE;
+    }
+    image.pixels.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * 4);
+    stbi_image_free(pixels);
+
+    // Compress level 0 and every halving down to 1x1, averaged as linear light
+    vector<MipLevel> mips = GenerateMipChain(image.pixels.data(), image.width, image.height, 4, MipFilter::Kaiser, true);
+    mips.insert(mips.begin(), image);
+    vector<vector<unsigned char>> levels;
+    size_t uncompressedSize = 0;
+    for (const MipLevel& mip : mips)
+    {
+        levels.push_back(EncodeBC1(mip));
+        uncompressedSize += static_cast<size_t>(mip.width) * mip.height * 3;
+    }
+
+    if (!WriteKTX2(outputFilename, vkFormat, image.width, image.height, levels))
+    {
+        cout << "Failed to write " << outputFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t compressedSize = 0;
+    for (const vector<unsigned char>& level : levels)
+        compressedSize += level.size();
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Cooked " << inputFilename << " (" << image.width << "x" << image.height << ", " << levels.size() << " levels) to "
+        << outputFilename << ": " << compressedSize / 1024 << " KB BC1 instead of " << uncompressedSize / 1024 << " KB RGB8 in "
+        << milliseconds << " ms" << endl;
+    return EXIT_SUCCESS;
+}